@@ -0,0 +1,229 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file analyze.cpp
+ * \brief Offline analysis of WAV recordings with the DSP and the measurements of the sensor, on all cores.
+ *
+ * The files are mapped and cut into segments of SEGMENT_FRAMES frames, the tasks of a
+ * work-stealing pool. A task runs SoundSensor::process() over the frames of its segment
+ * with a sensor of its own, the band energies of each frame go to the frame table of the
+ * file. The WARMUP frames before the segment are processed first and not kept, so the DC
+ * estimate and the filters have settled at the start.
+ *
+ * The merge runs the frames of a file in order through the WeightingBank, the A, C and Z
+ * measurements and the rolling Leq, as main.cpp does with the frames from the audio core,
+ * and closes a record every interval: min, max and avg of A, C and Z, the Z spectrum, the
+ * rolling LAeq and LAFmax, LASmax and LAImax, the values of the uplink, in dB. The merge
+ * takes about a microsecond per frame against tens for the DSP, each file is a task of the
+ * pool, so the analysis scales with the cores up to the number of segments.
+ *
+ * The warm-up makes the results of a segment independent of the others but not the same
+ * bits as one pass over the file, the difference is far below the 0.1 dB of the output.
+ * With --segment 0 a file is one segment, that is the replay of native/replay.cpp.
+ * The time of the records is the audio time from the start of the file.
+ *
+ * usage: analyze [--threads n] [--interval seconds] [--segment frames] file...
+ */
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "soundsensor.h"
+#include "measurement.h"
+#include "rollingleq.h"
+#include "wav.h"
+#include "workpool.h"
+
+#define SEGMENT_FRAMES 256          ///< frames per task, 23 s of audio, 12 s with overlap
+#define WARMUP 32                   ///< frames before a segment to settle the DC estimate and the filters
+#ifdef IIR_FILTERS
+#define FRAME_VALUES (BANDS + WEIGHTED_CURVES)   ///< band energies and the A and C weighted energy
+#else
+#define FRAME_VALUES BANDS
+#endif
+
+/// \brief a WAV file and the band energies of its frames
+struct Recording {
+  const char         *name;
+  WavFile             wav;
+  uint32_t            frames;
+  std::vector<float>  energies;     ///< FRAME_VALUES per frame
+  std::string         records;      ///< CSV lines of the intervals
+};
+
+/// \brief a task of the DSP, frames first .. first+count-1 of a file
+struct Segment {
+  Recording *recording;
+  uint32_t   first;
+  uint32_t   count;
+};
+
+static uint32_t intervalFrames = 1;
+
+static double seconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the DSP of a segment, frame k has the window of SAMPLES samples from k * BLOCK_SIZE on
+static void analyse(const Segment &segment) {
+  static thread_local int32_t window[SAMPLES];
+  Recording &recording = *segment.recording;
+  SoundSensor *sensor = new SoundSensor();
+  sensor->offset( MIC_OFFSET);
+  uint32_t start = (segment.first > WARMUP) ? segment.first - WARMUP : 0;
+  for (uint32_t k = start; k < segment.first + segment.count; k++) {
+    recording.wav.read((size_t)k * BLOCK_SIZE, SAMPLES, window);
+    float *energy = sensor->process( window, window + SAMPLES / 2);
+    if (k < segment.first)
+      continue;
+    float *values = &recording.energies[(size_t)k * FRAME_VALUES];
+    memcpy(values, energy, BANDS * sizeof(float));
+#ifdef IIR_FILTERS
+    memcpy(values + BANDS, sensor->weighted(), WEIGHTED_CURVES * sizeof(float));
+#endif
+  }
+  delete sensor;
+}
+
+static void record(std::string &records, const char *name, double start, double end, const Measurement::Result &la,
+                   const Measurement::Result &lc, const Measurement::Result &lz, const RollingLeq &leq) {
+  char line[64 + 8 * (MAX_BANDS + 21)];
+  int n = snprintf(line, sizeof(line), "%s,%.3f,%.3f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f",
+                   name, start, end, la.min, la.max, la.avg, lc.min, lc.max, lc.avg, lz.min, lz.max, lz.avg);
+  for (int i = 0; i < BANDS; i++)
+    n += snprintf(line + n, sizeof(line) - n, ",%.2f", lz.spectrum[i]);
+  for (int j = 0; j < ROLLING_WINDOWS; j++)
+    n += snprintf(line + n, sizeof(line) - n, ",%.2f", leq.leq(j));
+  snprintf(line + n, sizeof(line) - n, ",%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", la.fmax, la.smax, la.imax,
+           la.l5, la.l10, la.l50, la.l90, la.l95);
+  records += line;
+}
+
+// the measurements of the frames of a file in order, a record every interval
+static void merge(Recording &recording) {
+  static float aweighting[] = A_WEIGHTING;
+  static float cweighting[] = C_WEIGHTING;
+  static float zweighting[] = Z_WEIGHTING;
+  WeightingCurve aMeasurement( aweighting + FIRST_WEIGHTING, BANDS);
+  WeightingCurve cMeasurement( cweighting + FIRST_WEIGHTING, BANDS);
+  WeightingCurve zMeasurement( zweighting + FIRST_WEIGHTING, BANDS);
+  WeightingBank weightings( BANDS);
+  RollingLeq *rollingLeq = new RollingLeq();
+  weightings.add( &aMeasurement);
+  weightings.add( &cMeasurement);
+  weightings.add( &zMeasurement);
+  weightings.frameTime( (float)BLOCK_SIZE / SAMPLE_FREQ);
+
+  const double frameTime = (double)BLOCK_SIZE / SAMPLE_FREQ;
+  uint32_t first = 0;               // first frame of the interval
+  for (uint32_t k = 0; k < recording.frames; k++) {
+    const float *values = &recording.energies[(size_t)k * FRAME_VALUES];
+#ifdef IIR_FILTERS
+    weightings.update( values, values + BANDS, WEIGHTED_CURVES);
+#else
+    weightings.update( values);
+#endif
+    rollingLeq->add( weightings.energy( 0), (uint64_t)(k + 1) * BLOCK_SIZE * 1000 / SAMPLE_FREQ);
+    if (k + 1 - first == intervalFrames || k + 1 == recording.frames) {
+      weightings.calculate();
+      record(recording.records, recording.name, first * frameTime, (k + 1) * frameTime,
+             aMeasurement.result(), cMeasurement.result(), zMeasurement.result(), *rollingLeq);
+      first = k + 1;
+    }
+  }
+  delete rollingLeq;
+}
+
+int main(int argc, char *argv[]) {
+  int threads = 0;
+  double interval = CYCLETIME;
+  long segmentFrames = SEGMENT_FRAMES;
+  std::vector<Recording *> recordings;
+  bool usage = argc < 2;
+  for (int i = 1; i < argc && !usage; i++) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+      threads = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+      interval = atof(argv[++i]);
+    else if (strcmp(argv[i], "--segment") == 0 && i + 1 < argc)
+      segmentFrames = atol(argv[++i]);
+    else if (argv[i][0] != '-') {
+      Recording *recording = new Recording();
+      recording->name = argv[i];
+      recordings.push_back(recording);
+    }
+    else
+      usage = true;
+  }
+  if (usage || recordings.empty() || interval <= 0.0 || segmentFrames < 0) {
+    fprintf(stderr, "usage: %s [--threads n] [--interval seconds] [--segment frames] file...\n", argv[0]);
+    return 2;
+  }
+  intervalFrames = lround(interval / ((double)BLOCK_SIZE / SAMPLE_FREQ));
+  if (intervalFrames == 0)
+    intervalFrames = 1;
+
+  // the frames of the files and the segments of the DSP
+  std::vector<Segment> segments;
+  double audio = 0.0;
+  for (size_t f = 0; f < recordings.size(); f++) {
+    Recording &recording = *recordings[f];
+    if (!recording.wav.open(recording.name))
+      return 2;
+    if (recording.wav.rate() != SAMPLE_FREQ) {
+      fprintf(stderr, "%s is sampled at %u Hz, the sensor at %u Hz, resample it first\n",
+              recording.name, recording.wav.rate(), SAMPLE_FREQ);
+      return 2;
+    }
+    size_t count = recording.wav.count();
+    recording.frames = (count >= SAMPLES) ? (count - SAMPLES) / BLOCK_SIZE + 1 : 0;
+    recording.energies.resize((size_t)recording.frames * FRAME_VALUES);
+    audio += (double)count / SAMPLE_FREQ;
+    uint32_t size = (segmentFrames > 0) ? segmentFrames : recording.frames;
+    for (uint32_t first = 0; first < recording.frames; first += size) {
+      Segment segment = { &recording, first, (recording.frames - first < size) ? recording.frames - first : size };
+      segments.push_back(segment);
+    }
+  }
+
+  WorkPool pool(threads);
+  double start = seconds();
+  pool.run(segments.size(), [&segments](size_t task, int) {
+    analyse(segments[task]);
+  });
+  double dsp = seconds() - start;
+  pool.run(recordings.size(), [&recordings](size_t task, int) {
+    merge(*recordings[task]);
+  });
+  double elapsed = seconds() - start;
+
+  // the records in the order of the files
+  printf("file,start,end,la_min,la_max,la_avg,lc_min,lc_max,lc_avg,lz_min,lz_max,lz_avg");
+  for (int i = 0; i < BANDS; i++)
+    printf(",lz%d", i + 1);
+  for (int j = 0; j < ROLLING_WINDOWS; j++)
+    printf(",laeq%u", RollingLeq::seconds(j) / 60);
+  printf(",lafmax,lasmax,laimax,la5,la10,la50,la90,la95\n");
+  for (size_t f = 0; f < recordings.size(); f++)
+    fputs(recordings[f]->records.c_str(), stdout);
+
+  // the statistics go to stderr, so stdout is the CSV only
+  fprintf(stderr, "%u file(s), %.1f s of audio, %u segments on %d threads, %llu stolen\n",
+          (unsigned)recordings.size(), audio, (unsigned)segments.size(), pool.workers(),
+          (unsigned long long)pool.steals());
+  fprintf(stderr, "DSP %.2f s, merge %.2f s, %.0f times real time\n", dsp, elapsed - dsp,
+          (elapsed > 0.0) ? audio / elapsed : 0.0);
+  return 0;
+}
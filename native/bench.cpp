@@ -0,0 +1,555 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file bench.cpp
+ * \brief DSP benchmark of the sound sensor on the host, with a stored baseline.
+ *
+ * Each stage is timed as the fastest of ROUNDS rounds, a round calls the stage for at
+ * least ROUND_TIME. A round runs all stages in turn, so a slow spell of the host slows
+ * down a round of each stage rather than all rounds of some. The FFT stages run at
+ * 512, 1024, 2048 and 4096 samples, the stages of the SoundSensor and the end-to-end
+ * pipeline at the compiled SAMPLES and DSP options: 2048 in [env:native], 4096 in
+ * [env:native-wide] and 1024 in [env:native-1024].
+ *
+ * Host speeds differ, so the baseline holds the time of each stage relative to the
+ * reference stage, arduinoFFT::Compute of 2048 samples, measured in the same run.
+ * Stages of other DSP options keep their baseline entries. A stage slower than its
+ * baseline by more than the tolerance is measured again, up to RETRIES times, if it
+ * stays slower it is a regression and the benchmark exits with 1. The whole frame
+ * includes the hand-off between two host threads, it depends on the scheduler of the
+ * host more than on the DSP, so it is printed but not checked.
+ *
+ * Before the timing, Fft, RealFft and arduinoFFT::ComputeReal are checked against
+ * arduinoFFT::Compute of the same input at each size, the largest difference of a bin
+ * relative to the largest bin must stay below MAX_ERROR, a mismatch exits with 1 as well.
+ * The capture repeats one block of the noise, so after the timing the band energies of a
+ * frame are checked against arduinoFFT::Compute of the same window, each band within
+ * FRAME_TOLERANCE, with the filter bank the sum of the octaves.
+ *
+ * usage: program [--save] [--baseline file] [--tolerance fraction]
+ *   --save       write the measured stages into the baseline, after a deliberate change
+ */
+
+#include <Arduino.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include "soundsensor.h"
+#include "measurement.h"
+
+#define ROUNDS 25                   ///< rounds per stage, the fastest counts
+#define ROUND_TIME 0.004            ///< minimum duration of a round in s
+#define TOLERANCE 0.25              ///< allowed slowdown relative to the baseline
+#define RETRIES 2                   ///< measurements again before a slower stage is a regression
+#define BASELINE "native/baseline.txt"
+#define REFERENCE "arduinoFFT::Compute"
+#define REFERENCE_SIZE 2048
+#define MAX_SIZE 4096
+#define MAX_ERROR 1e-5              ///< allowed difference of a transform with arduinoFFT::Compute, relative to the largest bin
+#if defined(IIR_FILTERS)
+#define FRAME_TOLERANCE 0.5         ///< dB, all octaves of the filter bank together, a band has other slopes than the bins
+#elif defined(FIXED_POINT_DSP)
+#define FRAME_TOLERANCE 0.1         ///< dB, each band of the fixed point FFT, as in the conformance test
+#else
+#define FRAME_TOLERANCE 0.01        ///< dB, each band
+#endif
+
+// DSP options of this build, in the names of the SoundSensor stages
+#if defined(IIR_FILTERS)
+#define ENGINE "iir"
+#elif defined(FIXED_POINT_DSP)
+#define ENGINE "fixed"
+#else
+#define ENGINE "float"
+#endif
+#ifdef THIRD_OCTAVES
+#define ENGINE_BANDS "+third"
+#else
+#define ENGINE_BANDS ""
+#endif
+#ifdef OVERLAP_FRAMES
+#define ENGINE_OVERLAP "+overlap"
+#else
+#define ENGINE_OVERLAP ""
+#endif
+#define OPTIONS "/" ENGINE ENGINE_BANDS ENGINE_OVERLAP
+
+struct Stage {
+  std::string name;
+  uint16_t    size;                 ///< samples per frame, bands for the stages on the band energies
+  double      ns;                   ///< time per frame
+  double      baseline;             ///< relative time of the baseline, 0.0 if none
+  std::function<void()> run;        ///< one frame of the stage
+  uint32_t    calls;                ///< calls per round
+  std::function<double()> own;      ///< time per frame since the previous call, measured by the stage itself
+  bool        checked;              ///< compared with the baseline
+};
+
+static std::vector<Stage> measured;
+static std::vector<Stage> baseline;
+
+static float input[MAX_SIZE];       ///< noise, the same for every stage
+static int32_t samples[MAX_SIZE];   ///< the same noise as 24 bit I2S words
+static int mismatches = 0;          ///< transforms and frames that do not match arduinoFFT::Compute
+
+static double seconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double elapsed(Stage &stage) {
+  double start = seconds();
+  for (uint32_t i = 0; i < stage.calls; i++)
+    stage.run();
+  return seconds() - start;
+}
+
+static void add(const std::string &name, uint16_t size, std::function<void()> run,
+                std::function<double()> own = NULL, bool checked = true) {
+  Stage stage = { name, size, 0.0, 0.0, run, 1, own, checked };
+  measured.push_back(stage);
+}
+
+// time per frame in ns of all stages, the fastest round, also of the rounds of a previous call
+static void measure() {
+  for (size_t i = 0; i < measured.size(); i++) {
+    while (elapsed(measured[i]) < ROUND_TIME)
+      measured[i].calls *= 2;
+  }
+  for (int round = 0; round < ROUNDS; round++) {
+    for (size_t i = 0; i < measured.size(); i++) {
+      Stage &stage = measured[i];
+      if (stage.own)
+        stage.own();                // from the start of the round
+      double ns = elapsed(stage) * 1e9 / stage.calls;
+      if (stage.own)
+        ns = stage.own();
+      if (stage.ns == 0.0 || ns < stage.ns)
+        stage.ns = ns;
+    }
+  }
+}
+
+static void print() {
+  for (size_t i = 0; i < measured.size(); i++) {
+    const Stage &stage = measured[i];
+    printf("%-36s %5u %12.0f ns/frame %10.0f frames/s\n", stage.name.c_str(), stage.size, stage.ns, 1e9 / stage.ns);
+  }
+}
+
+// largest difference of the packed real spectrum of n values with the complex spectrum re, im,
+// relative to the largest bin, X[0] and X[n/2] are v[0] and v[1]
+static double deviation(const float *v, const float *re, const float *im, uint16_t n) {
+  double peak = 0.0;
+  for (uint16_t k = 0; k <= n / 2; k++)
+    peak = fmax(peak, hypot(re[k], im[k]));
+  double worst = fmax(fabs(v[0] - re[0]), fabs(v[1] - re[n / 2]));
+  for (uint16_t k = 1; k < n / 2; k++)
+    worst = fmax(worst, fmax(fabs(v[2 * k] - re[k]), fabs(v[2 * k + 1] - im[k])));
+  return (peak > 0.0) ? worst / peak : worst;
+}
+
+// the same for the complex spectrum of n interleaved values
+static double complexDeviation(const float *v, const float *re, const float *im, uint16_t n) {
+  double peak = 0.0, worst = 0.0;
+  for (uint16_t k = 0; k < n; k++) {
+    peak = fmax(peak, hypot(re[k], im[k]));
+    worst = fmax(worst, fmax(fabs(v[2 * k] - re[k]), fabs(v[2 * k + 1] - im[k])));
+  }
+  return (peak > 0.0) ? worst / peak : worst;
+}
+
+static void check(const char *name, uint16_t size, double error) {
+  bool match = error < MAX_ERROR;
+  if (!match)
+    mismatches++;
+  printf("%-36s %5u max error %.1e of the largest bin%s\n", name, size, error, match ? "" : ", MISMATCH");
+}
+
+// the transforms of real input against arduinoFFT::Compute of the same input
+template <uint16_t N>
+static void verify() {
+  static float re[N], im[N], v[N];
+  arduinoFFT reference(re, im, N, SAMPLE_FREQ);
+  memcpy(re, input, sizeof(re));
+  memset(im, 0, sizeof(im));
+  reference.Compute(FFT_FORWARD);
+
+  arduinoFFT fft(v, NULL, N, SAMPLE_FREQ);
+  memcpy(v, input, sizeof(v));
+  fft.ComputeReal();
+  check("arduinoFFT::ComputeReal", N, deviation(v, re, im, N));
+
+  static RealFft<N> realFft;
+  memcpy(v, input, sizeof(v));
+  realFft.forward(v);
+  check("RealFft::forward", N, deviation(v, re, im, N));
+
+  static Fft<N, 4> complexFft;
+  static float c[2 * N];
+  for (uint16_t i = 0; i < N; i++) {
+    c[2 * i] = input[i];
+    c[2 * i + 1] = 0.0f;
+  }
+  complexFft.forward(c);
+  check("Fft::forward", N, complexDeviation(c, re, im, N));
+}
+
+// FFT stages, each call starts from the same input so no values decay to denormals
+template <uint16_t N>
+static void transforms() {
+  verify<N>();
+  static float real[N], imag[N];
+  static int32_t fixed[N];
+  static arduinoFFT fft(real, imag, N, SAMPLE_FREQ);
+
+  add("arduinoFFT::Windowing", N, [&] {
+    memcpy(real, input, sizeof(real));
+    fft.Windowing(FFT_WIN_TYP_HANN, FFT_FORWARD);
+  });
+  add("arduinoFFT::Compute", N, [&] {
+    memcpy(real, input, sizeof(real));
+    memset(imag, 0, sizeof(imag));
+    fft.Compute(FFT_FORWARD);
+  });
+  add("arduinoFFT::ComputeReal", N, [&] {
+    memcpy(real, input, sizeof(real));
+    fft.ComputeReal();
+  });
+
+  static Fft<N, 4> complexFft;
+  static float complex[2 * N];
+  add("Fft::forward", N, [&] {
+    for (uint16_t i = 0; i < N; i++) {
+      complex[2 * i] = input[i];
+      complex[2 * i + 1] = 0.0f;
+    }
+    complexFft.forward(complex);
+  });
+
+  static RealFft<N> realFft;
+  add("RealFft::forward", N, [&] {
+    memcpy(real, input, sizeof(real));
+    realFft.forward(real);
+  });
+
+  static FixedRealFft<N> fixedFft;
+  add("FixedRealFft::forward", N, [&] {
+    for (uint16_t i = 0; i < N; i++)
+      fixed[i] = samples[i] >> (8 - FIXED_PRESHIFT);
+    fixedFft.forward(fixed);
+  });
+}
+
+/// \brief the private stages of the SoundSensor, at SAMPLES
+/// readSamples() is timed by the sensor itself, like its load(), without the wait for the capture task
+class Benchmark {
+  public:
+    static void stages(SoundSensor &sensor) {
+      const int32_t *older = samples;
+      const int32_t *newer = samples + SAMPLES / 2;
+#if defined(IIR_FILTERS)
+      (void)newer;
+      add("SoundSensor::integerToLevel" OPTIONS, SAMPLES, [&sensor, older] {
+        sensor.integerToLevel(older, sensor._real, BLOCK_SIZE);
+      });
+#elif defined(FIXED_POINT_DSP)
+      static int32_t input[SAMPLES];
+      add("SoundSensor::integerToFixed" OPTIONS, SAMPLES, [&sensor, older, newer] {
+        sensor.integerToFixed(older, newer, input, SAMPLES);
+      });
+      // the spectrum of the samples, apart from the input the conversion overwrites
+      static int32_t spectrum[SAMPLES];
+      sensor.integerToFixed(older, newer, spectrum, SAMPLES);
+      static int8_t exponent = sensor._transform.forward(spectrum);
+      add("SoundSensor::sumEnergyFixed" OPTIONS, SAMPLES, [&sensor] {
+        sensor.sumEnergyFixed(spectrum, exponent, sensor._bands, sensor._energy);
+      });
+#else
+      add("SoundSensor::integerToFloat" OPTIONS, SAMPLES, [&sensor, older, newer] {
+        sensor.integerToFloat(older, newer, sensor._real, SAMPLES);
+      });
+      // the spectrum of the samples, apart from _real the conversion overwrites
+      static float spectrum[SAMPLES];
+      sensor.integerToFloat(older, newer, spectrum, SAMPLES);
+      sensor._transform.forward(spectrum);
+      add("SoundSensor::sumEnergy" OPTIONS, SAMPLES, [&sensor] {
+        sensor.sumEnergy(spectrum, sensor._bands, sensor._energy);
+      });
+#endif
+      add("SoundSensor::readSamples" OPTIONS, SAMPLES, [&sensor] {
+        sensor.readSamples();
+      }, [&sensor] {
+        double ns = (sensor._frames > 0) ? sensor._busy * 1000.0 / sensor._frames : 0.0;
+        sensor._busy = 0;
+        sensor._frames = 0;
+        return ns;
+      });
+    }
+
+    /// \brief the band energies of the next frame against arduinoFFT::Compute of the same window
+    /// the capture repeats one block, so every window is known, and the DC is the estimate the frame starts from
+    static void verify(SoundSensor &sensor) {
+      static float re[SAMPLES], im[SAMPLES];
+      arduinoFFT reference(re, im, SAMPLES, SAMPLE_FREQ);
+      const float *hann = reference.WindowTable(FFT_WIN_TYP_HANN);
+      double dc = sensor._runningDC;
+      for (int i = 0; i < SAMPLES; i++) {
+        int w = (i < SAMPLES / 2) ? i : SAMPLES - 1 - i;
+        re[i] = (float)(((samples[i % BLOCK_SIZE] >> 8) - dc) * sensor._gain * hann[w]);
+        im[i] = 0.0f;
+      }
+      reference.Compute(FFT_FORWARD);
+      const float *energies = sensor.readSamples();
+
+      // the bins of the bands of the FFT engines, whole octaves for the filter bank
+      BandMap map;
+#ifdef IIR_FILTERS
+      map.octaves(OCTAVE_FIRST_BIN, OCTAVES);
+#else
+      map = sensor._bands;
+#endif
+      double worst = 0.0, total = 0.0, expectedTotal = 0.0;
+      for (int b = 0; b < BANDS; b++) {
+        double expected = 0.0;
+        for (int bin = map.first[b]; bin <= map.last[b]; bin++)
+          expected += (double)re[bin] * re[bin] + (double)im[bin] * im[bin];
+        expected -= map.lowCut[b] * ((double)re[map.first[b]] * re[map.first[b]] + (double)im[map.first[b]] * im[map.first[b]]);
+        expected -= map.highCut[b] * ((double)re[map.last[b]] * re[map.last[b]] + (double)im[map.last[b]] * im[map.last[b]]);
+#ifndef IIR_FILTERS
+        worst = fmax(worst, fabs(10.0 * log10(energies[b] / expected)));
+#endif
+        total += energies[b];
+        expectedTotal += expected;
+      }
+      worst = fmax(worst, fabs(10.0 * log10(total / expectedTotal)));
+      bool match = worst < FRAME_TOLERANCE;
+      if (!match)
+        mismatches++;
+      printf("%-36s %5u max error %.4f dB of a band against %s%s\n", "frame" OPTIONS, SAMPLES, worst, REFERENCE,
+             match ? "" : ", MISMATCH");
+    }
+};
+
+// the samples of the capture, the first block of the noise over and over
+static void repeated(int32_t *dest, size_t count) {
+  static size_t position = 0;
+  for (size_t i = 0; i < count; i++) {
+    dest[i] = samples[position];
+    position = (position + 1) % BLOCK_SIZE;
+  }
+}
+
+// stages on the band energies of a frame, and the end-to-end pipeline of the device
+static void pipeline(SoundSensor &sensor) {
+  static float aweighting[] = A_WEIGHTING;
+  static float cweighting[] = C_WEIGHTING;
+  static float zweighting[] = Z_WEIGHTING;
+  static float single[] = A_WEIGHTING;
+  static WeightingCurve aMeasurement( aweighting + FIRST_WEIGHTING, BANDS);
+  static WeightingCurve cMeasurement( cweighting + FIRST_WEIGHTING, BANDS);
+  static WeightingCurve zMeasurement( zweighting + FIRST_WEIGHTING, BANDS);
+  static Measurement measurement( single + FIRST_WEIGHTING, BANDS);
+  static WeightingBank weightings( BANDS);
+  weightings.add( &aMeasurement);
+  weightings.add( &cMeasurement);
+  weightings.add( &zMeasurement);
+
+  static float energies[BANDS];
+  for (int i = 0; i < BANDS; i++)
+    energies[i] = 1e6 * (i + 1);
+  add("Measurement::update" OPTIONS, BANDS, [&] {
+    measurement.update( energies);
+  });
+  add("WeightingBank::update" OPTIONS, BANDS, [&] {
+    weightings.update( energies);
+  });
+
+  // a frame as the device loop sees it, with the hand-off from the capture task
+  add("frame" OPTIONS, SAMPLES, [&sensor] {
+#ifdef IIR_FILTERS
+    weightings.update( sensor.readSamples(), sensor.weighted(), WEIGHTED_CURVES);
+#else
+    weightings.update( sensor.readSamples());
+#endif
+  }, NULL, false);
+}
+
+static bool load(const char *file) {
+  FILE *f = fopen(file, "r");
+  if (f == NULL)
+    return false;
+  char line[256], name[128];
+  unsigned size;
+  double ratio;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (line[0] == '#')
+      continue;
+    if (sscanf(line, "%127s %u %lf", name, &size, &ratio) == 3) {
+      Stage stage = { name, (uint16_t)size, 0.0, ratio, NULL, 0, NULL, true };
+      baseline.push_back(stage);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static Stage *find(std::vector<Stage> &stages, const std::string &name, uint16_t size) {
+  for (size_t i = 0; i < stages.size(); i++) {
+    if (stages[i].name == name && stages[i].size == size)
+      return &stages[i];
+  }
+  return NULL;
+}
+
+// measured stages replace their entries, the entries of other builds are kept
+static bool save(const char *file, double reference) {
+  for (size_t i = 0; i < measured.size(); i++) {
+    if (!measured[i].checked)
+      continue;
+    Stage *entry = find(baseline, measured[i].name, measured[i].size);
+    if (entry == NULL) {
+      baseline.push_back(measured[i]);
+      entry = &baseline.back();
+    }
+    entry->baseline = measured[i].ns / reference;
+  }
+  FILE *f = fopen(file, "w");
+  if (f == NULL)
+    return false;
+  fprintf(f, "# DSP benchmark baseline, native/bench.cpp\n");
+  fprintf(f, "# stage, samples per frame or bands, time relative to %s of %u samples\n", REFERENCE, REFERENCE_SIZE);
+  for (size_t i = 0; i < baseline.size(); i++)
+    fprintf(f, "%s %u %.4f\n", baseline[i].name.c_str(), baseline[i].size, baseline[i].baseline);
+  fclose(f);
+  return true;
+}
+
+// compare the measured stages with the baseline, returns the number of regressions
+static int compare(double reference, double tolerance, bool verbose) {
+  int regressions = 0;
+  if (verbose)
+    printf("\n%-36s %5s %9s %9s %8s\n", "stage", "size", "baseline", "now", "change");
+  for (size_t i = 0; i < measured.size(); i++) {
+    const Stage &stage = measured[i];
+    double now = stage.ns / reference;
+    if (!stage.checked) {
+      if (verbose)
+        printf("%-36s %5u %9s %9.4f %8s not checked\n", stage.name.c_str(), stage.size, "-", now, "-");
+      continue;
+    }
+    Stage *entry = find(baseline, stage.name, stage.size);
+    if (entry == NULL) {
+      if (verbose)
+        printf("%-36s %5u %9s %9.4f %8s new\n", stage.name.c_str(), stage.size, "-", now, "-");
+      continue;
+    }
+    double change = now / entry->baseline - 1.0;
+    const char *verdict = "";
+    if (change > tolerance) {
+      verdict = "REGRESSION";
+      regressions++;
+    }
+    else if (change < -tolerance)
+      verdict = "faster, --save to keep";
+    if (verbose)
+      printf("%-36s %5u %9.4f %9.4f %+7.1f%% %s\n", stage.name.c_str(), stage.size, entry->baseline, now,
+             100.0 * change, verdict);
+  }
+  return regressions;
+}
+
+int main(int argc, char *argv[]) {
+  bool store = false;
+  const char *file = BASELINE;
+  double tolerance = TOLERANCE;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--save") == 0)
+      store = true;
+    else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+      file = argv[++i];
+    else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+      tolerance = atof(argv[++i]);
+    else {
+      printf("usage: %s [--save] [--baseline file] [--tolerance fraction]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  // white noise at -30 dBFS, from a fixed seed
+  uint32_t state = 2463534242u;
+  for (int i = 0; i < MAX_SIZE; i++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    samples[i] = (int32_t)(state & 0xfff80000) >> 5;
+    input[i] = (samples[i] >> 8) / 8388608.0f;
+  }
+
+  printf("DSP benchmark, %u samples at %u Hz, %d bands, options %s\n\n",
+         SAMPLES, SAMPLE_FREQ, BANDS, OPTIONS + 1);
+  transforms<512>();
+  transforms<1024>();
+  transforms<2048>();
+  transforms<4096>();
+  printf("\n");
+  // the capture task runs on a host thread, the stand-in I2S driver never waits
+  i2sSource(repeated);
+  static SoundSensor sensor;
+  sensor.begin();
+  sensor.start();
+  Benchmark::stages(sensor);
+  pipeline(sensor);
+  measure();
+
+  bool loaded = load(file);
+  int regressions = 0;
+  if (loaded && !store) {
+    for (int retry = 0; retry < RETRIES; retry++) {
+      double reference = find(measured, REFERENCE, REFERENCE_SIZE)->ns;
+      regressions = compare(reference, tolerance, false);
+      if (regressions == 0)
+        break;
+      printf("%d stage(s) slower than the baseline, measuring again\n", regressions);
+      measure();
+    }
+  }
+  Benchmark::verify(sensor);
+  sensor.stop();
+  print();
+
+  double reference = find(measured, REFERENCE, REFERENCE_SIZE)->ns;
+  if (store) {
+    if (!save(file, reference)) {
+      printf("\ncannot write %s\n", file);
+      return 2;
+    }
+    printf("\nbaseline saved in %s\n", file);
+    return 0;
+  }
+  if (!loaded) {
+    printf("\nno baseline in %s, run with --save to store one\n", file);
+    return (mismatches > 0) ? 1 : 0;
+  }
+  regressions = compare(reference, tolerance, true);
+  if (mismatches > 0)
+    printf("\n%d transform(s) or frame(s) do not match arduinoFFT::Compute\n", mismatches);
+  if (regressions > 0) {
+    printf("\n%d stage(s) regressed more than %.0f%% against %s\n", regressions, 100.0 * tolerance, file);
+    return 1;
+  }
+  printf("\nno regressions against %s\n", file);
+  return (mismatches > 0) ? 1 : 0;
+}
@@ -0,0 +1,613 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file conformance.cpp
+ * \brief Accuracy and throughput of the DSP of the sensor on synthetic signals, on the host.
+ *
+ * Each signal of signals.h runs through SoundSensor::process() with the DSP options of this
+ * build and through the A and Z measurements of main.cpp. The levels are compared with what
+ * the signal must give. The energy of a signal of mean square ms in full scale units is
+ *   0.75 * (0.54 * CALIBRATION_SAMPLES * 2^15 * mic. correction / FACTOR)^2 * ms
+ * from the 24 bit samples, the gain of SoundSensor::offset() and the HANN window of
+ * 0.54 * (1 - cos), the one sided spectrum holds half of the energy. A band holds the part of
+ * the signal between its edges in the engine: all of a tone, bandwidth / (fs / 2) of white
+ * noise, the same energy per octave of pink noise, the time in the band of a logarithmic
+ * sweep, the harmonics of a clipped sine from its Fourier series, folded at fs / 2 as
+ * sampling does. Tone bursts give the average over the duty cycle and the max of the fast,
+ * slow and impulse time weighting of a periodic burst.
+ *
+ * The first WARMUP frames of a signal settle the DC estimate and the filters and are not
+ * measured. A tone is checked in its band when the engine separates it from the band edges,
+ * 2.5 bins for an FFT, a third octave for the filters. Bands of less than 2 bins are not
+ * checked with noise and sweeps. Every check has a tolerance in dB, any failed check gives
+ * exit code 1, so a new engine or mode is accepted or rejected on the numbers.
+ *
+ * In every build FixedRealFft is also compared with RealFft on the same windowed frames of
+ * noise and sines, with the HANN window and the Q31 input of the sensor, as the octave
+ * energies of the single FFT. A band within FIXED_RANGE of the strongest band must have the
+ * same level within FIXED_TOLERANCE, the fixed point error is printed per band with --verbose.
+ *
+ * The DSP time of each signal is measured around process() only, so a signal that is slow
+ * on some engine stands out, like the digital silence after a burst for filters that decay
+ * into the denormals. --record appends the results of the build to a file, one line
+ * per run: options, checks, failed checks, worst deviation in dB, ns per frame and the
+ * times real time, to compare the options.
+ *
+ * usage: conformance [--verbose] [--record file]
+ */
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "soundsensor.h"
+#include "measurement.h"
+#include "signals.h"
+
+#define WARMUP 32                   ///< frames before the measurement, the DC estimate and the filters settle
+#define LEVEL -20.0                 ///< test level in dBFS, peak of a sine, rms of noise
+#define TONE_TOLERANCE 0.5          ///< dB, level of a tone in its band
+#define NOISE_TOLERANCE 0.5         ///< dB, level of noise in a band
+#define TIME_TOLERANCE 0.5          ///< dB, time weighted max of tone bursts
+#define CLIP_RANGE 40.0             ///< dB, harmonics of a clipped sine below the fundamental are not checked
+#define EDGE_BINS 2.5               ///< the main lobe of the HANN window is 2 bins at each side, a tone nearer to a band edge is in two bands
+#define FIXED_TOLERANCE 0.1         ///< dB, the fixed point FFT against the float FFT
+#define FIXED_RANGE 60.0            ///< dB, bands further below the strongest band hold leakage only and are not checked
+#define FIXED_FRAMES 50             ///< frames per signal of the fixed point comparison
+
+// rejection of a tone in the other bands, and how far from a band edge the engine separates a tone
+#if defined(IIR_FILTERS)
+#define NEXT_REJECTION 10.0         ///< dB, the octave filters are 4th order band passes, the top octave a 3rd order high pass
+#define REJECTION 30.0
+#define EDGE_OCTAVES 0.33           ///< the slopes of the filters
+#define TOTAL_TOLERANCE 0.5         ///< dB, level of all bands together, the slopes of the filters overlap
+#define WEIGHTING_TOLERANCE 0.5     ///< dB, the A weighting filter against the curve of IEC 61672
+#define HIGH_WEIGHTING_TOLERANCE 2.0  ///< dB, above fs/8, with the bilinear transform the filter is 1 dB low at 8 kHz, 1.5 dB at 16 kHz wide band
+#else
+#define NEXT_REJECTION 25.0
+#define REJECTION 40.0
+#define EDGE_OCTAVES 0.0
+#define TOTAL_TOLERANCE 0.3
+#endif
+
+// DSP options of this build, as in bench.cpp
+#if defined(IIR_FILTERS)
+#define ENGINE "iir"
+#elif defined(FIXED_POINT_DSP)
+#define ENGINE "fixed"
+#else
+#define ENGINE "float"
+#endif
+#ifdef THIRD_OCTAVES
+#define ENGINE_BANDS "+third"
+#else
+#define ENGINE_BANDS ""
+#endif
+#ifdef OVERLAP_FRAMES
+#define ENGINE_OVERLAP "+overlap"
+#else
+#define ENGINE_OVERLAP ""
+#endif
+#ifdef WIDE_BAND
+#define ENGINE_WIDE "+wide"
+#else
+#define ENGINE_WIDE ""
+#endif
+#define OPTIONS ENGINE ENGINE_BANDS ENGINE_OVERLAP ENGINE_WIDE
+
+/// \brief edges and nominal centre of a band in Hz
+struct Band {
+  double low, centre, high;
+  double bin;                       ///< FFT bin width of the band, 0.0 for the filters
+};
+
+/// \brief levels of a signal and the DSP time
+struct Levels {
+  Measurement::Result la, lz;
+  uint32_t frames;
+  double   seconds;
+};
+
+/// \brief checks of one signal
+struct Test {
+  std::string name;
+  int      checks;
+  int      failed;
+  double   worst;                   ///< largest deviation from the expected level in dB
+  uint32_t frames;
+  double   seconds;
+  bool     dsp;                     ///< seconds is the time of process(), counted in the throughput of the build
+};
+
+static Band bands[BANDS];
+static std::vector<Test> tests;
+static bool verbose = false;
+static const double frameTime = (double)BLOCK_SIZE / SAMPLE_FREQ;
+static const double binWidth = (double)SAMPLE_FREQ / SAMPLES;
+
+static double seconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double decibel(double energy) {
+  return 10.0 * log10(energy);
+}
+
+static double amplitude(double dBFS) {
+  return pow(10.0, dBFS / 20.0);
+}
+
+// level of a signal of mean square ms in full scale units, see the top of this file
+static double level(double ms) {
+  double scale = 0.54 * CALIBRATION_SAMPLES * 32768.0 * pow(10.0, MIC_OFFSET / 20.0) / FACTOR;
+  return decibel(0.75 * scale * scale * ms);
+}
+
+// the bands of this build with the edges of the engine, whole octaves numbered from 16 Hz or third octaves
+// from 25 Hz, bin k of an FFT covers k - 0.5 .. k + 0.5 bins, so the binary octaves of the FFT engines
+// start half a bin below the nominal octave, the 31.5 Hz octave of the single FFT is 16.6 .. 38.7 Hz
+static void edges() {
+  for (int b = 0; b < BANDS; b++) {
+#ifdef THIRD_OCTAVES
+    double centre = 1000.0 * pow(10.0, (b - 16) / 10.0);
+    bands[b].low = centre / pow(10.0, 0.05);
+    bands[b].high = centre * pow(10.0, 0.05);
+    bands[b].bin = binWidth;
+#else
+    double centre = 1000.0 * pow(2.0, FIRST_OCTAVE + b - 6);
+    bands[b].low = centre / sqrt(2.0);     // the octave filters have the nominal edges
+    bands[b].high = centre * sqrt(2.0);
+    bands[b].bin = 0.0;
+#if !defined(IIR_FILTERS)
+    bands[b].low = ((OCTAVE_FIRST_BIN << b) - 0.5) * binWidth;   // bins 2^(b+1) .. 2^(b+2) - 1 at 2048 samples
+    bands[b].high = ((2 * OCTAVE_FIRST_BIN << b) - 0.5) * binWidth;
+    bands[b].bin = binWidth;
+#endif
+#endif
+    bands[b].centre = centre;
+  }
+}
+
+// the band of a frequency, -1 outside all bands
+static int band(double frequency) {
+  for (int b = 0; b < BANDS; b++) {
+    if (frequency >= bands[b].low && frequency < bands[b].high)
+      return b;
+  }
+  return -1;
+}
+
+// a tone away from the edges of its band, fs/2 is an edge too: the FFT sees a tone and its mirror image
+static bool resolved(double frequency, int b) {
+  double high = (bands[b].high < SAMPLE_FREQ / 2.0) ? bands[b].high : SAMPLE_FREQ / 2.0;
+  return frequency - bands[b].low >= EDGE_BINS * bands[b].bin && high - frequency >= EDGE_BINS * bands[b].bin &&
+         log2(frequency / bands[b].low) >= EDGE_OCTAVES && log2(high / frequency) >= EDGE_OCTAVES;
+}
+
+// a band of less than 2 bins holds more of the window leakage of its neighbours than of its own part of a spectrum
+static bool narrow(int b) {
+  return bands[b].high - bands[b].low < 2.0 * bands[b].bin;
+}
+
+#ifdef IIR_FILTERS
+// A weighting of IEC 61672 in dB
+static double aWeighting(double f) {
+  double f2 = f * f;
+  double ra = 12194.0 * 12194.0 * f2 * f2 / ((f2 + 20.6 * 20.6) * sqrt((f2 + 107.7 * 107.7) * (f2 + 737.9 * 737.9)) *
+                                             (f2 + 12194.0 * 12194.0));
+  return 20.0 * log10(ra) + 2.0;
+}
+#endif
+
+// frames is rounded so that a time in the test signals is a whole number of frames
+static uint32_t frames(double time) {
+  return (uint32_t)lround(time / frameTime);
+}
+
+// run the frames of a signal through the DSP and the measurements, after WARMUP frames
+static Levels run(const Signal &signal, uint32_t count) {
+  static int32_t samples[SAMPLES];  // the last SAMPLES samples of the signal
+  static int32_t window[SAMPLES];   // copy for process(), which may overwrite it
+  float aweighting[] = A_WEIGHTING;
+  float cweighting[] = C_WEIGHTING;
+  float zweighting[] = Z_WEIGHTING;
+  WeightingCurve aMeasurement( aweighting + FIRST_WEIGHTING, BANDS);
+  WeightingCurve cMeasurement( cweighting + FIRST_WEIGHTING, BANDS);
+  WeightingCurve zMeasurement( zweighting + FIRST_WEIGHTING, BANDS);
+  WeightingBank weightings( BANDS);
+  weightings.add( &aMeasurement);
+  weightings.add( &cMeasurement);
+  weightings.add( &zMeasurement);
+  weightings.frameTime( frameTime);
+
+  SoundSensor *sensor = new SoundSensor();
+  sensor->offset( MIC_OFFSET);
+  SignalGenerator generator(signal, SAMPLE_FREQ);
+  memset(samples, 0, sizeof(samples));
+  // with OVERLAP_FRAMES the first window starts with the priming half block
+  if (SAMPLES > BLOCK_SIZE)
+    generator.read(samples + BLOCK_SIZE, SAMPLES - BLOCK_SIZE);
+  Levels levels;
+  levels.frames = count;
+  levels.seconds = 0.0;
+  for (uint32_t k = 0; k < WARMUP + count; k++) {
+    memmove(samples, samples + BLOCK_SIZE, (SAMPLES - BLOCK_SIZE) * sizeof(int32_t));
+    generator.read(samples + SAMPLES - BLOCK_SIZE, BLOCK_SIZE);
+    memcpy(window, samples, sizeof(window));
+    double start = seconds();
+    float *energy = sensor->process( window, window + SAMPLES / 2);
+    if (k < WARMUP)
+      continue;
+    levels.seconds += seconds() - start;
+#ifdef IIR_FILTERS
+    weightings.update( energy, sensor->weighted(), WEIGHTED_CURVES);
+#else
+    weightings.update( energy);
+#endif
+  }
+  weightings.calculate();
+  levels.la = aMeasurement.result();
+  levels.lz = zMeasurement.result();
+  delete sensor;
+  return levels;
+}
+
+static Test &begin(const std::string &name, const Levels &levels) {
+  Test test = { name, 0, 0, 0.0, levels.frames, levels.seconds, true };
+  tests.push_back(test);
+  if (verbose)
+    printf("%s\n", name.c_str());
+  return tests.back();
+}
+
+// verbose prints the checks under the name of the signal, a failure alone needs the name
+static std::string label(const Test &test, const std::string &what) {
+  return verbose ? what : test.name + ", " + what;
+}
+
+// a level within tolerance of the expected level
+static void check(Test &test, const std::string &what, double measured, double expected, double tolerance) {
+  double deviation = measured - expected;
+  bool pass = fabs(deviation) <= tolerance;
+  test.checks++;
+  test.failed += !pass;
+  if (fabs(deviation) > test.worst)
+    test.worst = fabs(deviation);
+  if (verbose || !pass)
+    printf("  %-4s %-40s %8.2f dB, expected %8.2f +- %.2f dB, %+6.2f dB\n", pass ? "ok" : "FAIL",
+           label(test, what).c_str(), measured, expected, tolerance, deviation);
+}
+
+// a level at most limit
+static void below(Test &test, const std::string &what, double measured, double limit) {
+  bool pass = measured <= limit;
+  test.checks++;
+  test.failed += !pass;
+  if (verbose || !pass)
+    printf("  %-4s %-40s %8.2f dB, at most %8.2f dB\n", pass ? "ok" : "FAIL", label(test, what).c_str(), measured, limit);
+}
+
+static std::string name(const char *format, double value) {
+  char text[64];
+  snprintf(text, sizeof(text), format, value);
+  return text;
+}
+
+// a tone in its band, rejected in the others, and its A weighting
+static void tone(const std::string &title, double frequency, double dBFS, const Levels &levels) {
+  Test &test = begin(title, levels);
+  int b = band(frequency);
+  double expected = level(amplitude(dBFS) * amplitude(dBFS) / 2.0);
+  check(test, name("band %.0f Hz", bands[b].centre), levels.lz.spectrum[b], expected, TONE_TOLERANCE);
+  check(test, "LZ", levels.lz.avg, expected, TOTAL_TOLERANCE);
+  for (int i = 0; i < BANDS; i++) {
+    if (i != b)
+      below(test, name("band %.0f Hz", bands[i].centre), levels.lz.spectrum[i],
+            expected - ((abs(i - b) == 1) ? NEXT_REJECTION : REJECTION));
+  }
+#ifdef IIR_FILTERS
+  // the A weighting filter, the FFT engines weigh the bands with the table of measurement.h
+  check(test, "LA - LZ", levels.la.avg - levels.lz.avg, aWeighting(frequency),
+        (frequency < SAMPLE_FREQ / 8.0) ? WEIGHTING_TOLERANCE : HIGH_WEIGHTING_TOLERANCE);
+#endif
+}
+
+// sines at the centre of each band, on a bin centre and half way two bins, where the FFT has the largest scalloping,
+// for the filters at the centre and a bit above it
+static void tones() {
+  for (int b = 0; b < BANDS; b++) {
+    double bin = bands[b].bin;
+    double on = (bin > 0.0) ? round(bands[b].centre / bin) * bin : bands[b].centre;
+    double off = (bin > 0.0) ? (floor(bands[b].centre / bin) + 0.5) * bin : bands[b].centre * 1.05;
+    double frequencies[2] = { on, off };
+    for (int k = 0; k < 2; k++) {
+      double f = frequencies[k];
+      if (!resolved(f, b))
+        continue;
+      tone(name((k && bin > 0.0) ? "sine %.1f Hz between bins" : "sine %.1f Hz", f), f, LEVEL,
+           run(sine(f, amplitude(LEVEL)), frames(5.0)));
+    }
+  }
+}
+
+// the level of a 1 kHz tone from full scale down to the noise floor of a MEMS microphone
+static void linearity() {
+  double f = round(1000.0 / binWidth) * binWidth;
+  for (int dB = 0; dB >= -80; dB -= 20)
+    tone(name("sine 1 kHz at %.0f dBFS", dB), f, dB, run(sine(f, amplitude(dB)), frames(5.0)));
+}
+
+// a DC offset, as the microphones have, is removed before the bands
+static void offset() {
+  double f = round(1000.0 / binWidth) * binWidth;
+  Signal signal = sine(f, amplitude(LEVEL));
+  signal.offset = 0.25;
+  tone("sine 1 kHz with a DC offset of 0.25", f, LEVEL, run(signal, frames(5.0)));
+}
+
+// a logarithmic sweep spends the same time in each octave
+static void sweeps() {
+  double from = 10.0, to = 0.45 * SAMPLE_FREQ;
+  uint32_t sweepFrames = frames(10.0);
+  Levels levels = run(sweep(from, to, sweepFrames * frameTime, amplitude(LEVEL)), 3 * sweepFrames);
+  Test &test = begin(name("sweep %.0f Hz", from) + name(" .. %.0f Hz", to), levels);
+  double ms = amplitude(LEVEL) * amplitude(LEVEL) / 2.0;
+  double total = 0.0;
+  for (int b = 0; b < BANDS; b++) {
+    double low = (bands[b].low > from) ? bands[b].low : from;
+    double high = (bands[b].high < to) ? bands[b].high : to;
+    double part = (high > low) ? log(high / low) / log(to / from) : 0.0;
+    total += part;
+    // the FFT of a band at the start or end of the sweep also holds the sides of the window
+    if (bands[b].low >= from * sqrt(2.0) && bands[b].high <= to / sqrt(2.0) && !narrow(b))
+      check(test, name("band %.0f Hz", bands[b].centre), levels.lz.spectrum[b], level(ms * part), NOISE_TOLERANCE);
+  }
+  check(test, "LZ", levels.lz.avg, level(ms * total), TOTAL_TOLERANCE);
+}
+
+// white noise has the same energy per Hz, pink noise per octave
+static void noise() {
+  double ms = amplitude(LEVEL) * amplitude(LEVEL);
+  Levels levels = run(whiteNoise(amplitude(LEVEL)), frames(60.0));
+  Test &white = begin("white noise", levels);
+  double total = 0.0;
+  for (int b = 0; b < BANDS; b++) {
+    double high = (bands[b].high < SAMPLE_FREQ / 2.0) ? bands[b].high : SAMPLE_FREQ / 2.0;
+    double part = (high - bands[b].low) / (SAMPLE_FREQ / 2.0);
+    total += part;
+    if (!narrow(b))
+      check(white, name("band %.0f Hz", bands[b].centre), levels.lz.spectrum[b], level(ms * part), NOISE_TOLERANCE);
+  }
+  check(white, "LZ", levels.lz.avg, level(ms * total), TOTAL_TOLERANCE);
+
+  // the fraction in the bands depends on the lowest frequency of the noise, so the bands are compared with their mean
+  levels = run(pinkNoise(amplitude(LEVEL)), frames(60.0));
+  Test &pink = begin("pink noise", levels);
+  double density[BANDS], mean = 0.0;
+  int count = 0;
+  for (int b = 0; b < BANDS; b++) {
+    density[b] = levels.lz.spectrum[b] - decibel(log2(bands[b].high / bands[b].low));
+    if (!narrow(b)) {
+      mean += density[b];
+      count++;
+    }
+  }
+  mean /= count;
+  for (int b = 0; b < BANDS; b++) {
+    if (!narrow(b))
+      check(pink, name("band %.0f Hz per octave", bands[b].centre), density[b], mean, NOISE_TOLERANCE);
+  }
+}
+
+// level of exponential time weighting at the end of periodic bursts of energy 1.0
+static double periodic(double on, double period, double rise, double decay) {
+  double a = exp(-on / rise), b = exp(-(period - on) / decay);
+  return decibel((1.0 - a) / (1.0 - a * b));
+}
+
+// tone bursts, the average and the fast, slow and impulse max
+static void bursts() {
+  double f = round(1000.0 / binWidth) * binWidth;
+  double period = frames(2.0) * frameTime, on = frames(0.5) * frameTime;
+  Signal signal = sine(f, amplitude(LEVEL));
+  signal.burstOn = on;
+  signal.burstPeriod = period;
+  Levels levels = run(signal, 20 * frames(2.0));
+  Test &test = begin(name("tone bursts 1 kHz %.2f s", on) + name(" every %.2f s", period), levels);
+  double expected = level(amplitude(LEVEL) * amplitude(LEVEL) / 2.0);
+  check(test, "LZ", levels.lz.avg, expected + decibel(on / period), TOTAL_TOLERANCE);
+  check(test, "LZFmax", levels.lz.fmax, expected + periodic(on, period, TAU_FAST, TAU_FAST), TIME_TOLERANCE);
+  check(test, "LZSmax", levels.lz.smax, expected + periodic(on, period, TAU_SLOW, TAU_SLOW), TIME_TOLERANCE);
+  check(test, "LZImax", levels.lz.imax, expected + periodic(on, period, TAU_IMPULSE, TAU_IMPULSE_DECAY), TIME_TOLERANCE);
+}
+
+// digital silence after short tone bursts, the filter states decay into the denormals, see the DSP time
+static void silence() {
+  double f = round(1000.0 / binWidth) * binWidth;
+  double period = frames(20.0) * frameTime, on = frames(0.5) * frameTime;
+  Signal signal = sine(f, amplitude(LEVEL));
+  signal.burstOn = on;
+  signal.burstPeriod = period;
+  Levels levels = run(signal, 2 * frames(20.0));
+  Test &test = begin(name("silence after bursts of %.2f s", on) + name(" every %.0f s", period), levels);
+  double expected = level(amplitude(LEVEL) * amplitude(LEVEL) / 2.0);
+  check(test, "LZ", levels.lz.avg, expected + decibel(on / period), TOTAL_TOLERANCE);
+}
+
+// a full scale sine clipped at half scale, odd harmonics of the Fourier series of the clipped sine
+static void clipping() {
+  double f = round(1000.0 / binWidth) * binWidth;
+  double clip = 0.5;
+  Signal signal = sine(f, 1.0);
+  signal.clip = clip;
+  Levels levels = run(signal, frames(5.0));
+  Test &test = begin(name("sine 1 kHz clipped at %.1f", clip), levels);
+
+  // b_n = 4 / pi * (integral of sin(x) sin(n x) up to x0 + clip * integral of sin(n x) from x0 to pi / 2)
+  // a harmonic near a band edge or fs/2 is in two bands, a band is not checked when such a harmonic
+  // in it or next to it has more than 1% of its energy
+  double x0 = asin(clip);
+  double energy[BANDS] = { 0.0 }, spoiled[BANDS] = { 0.0 }, fundamental = 0.0, total = 0.0;
+  for (int n = 1; n < 1000; n += 2) {
+    double up = (n == 1) ? (x0 - sin(2.0 * x0) / 2.0) / 2.0 : (sin((n - 1) * x0) / (n - 1) - sin((n + 1) * x0) / (n + 1)) / 2.0;
+    double bn = 4.0 / M_PI * (up + clip * cos(n * x0) / n);
+    double harmonic = fmod(n * f, (double)SAMPLE_FREQ);
+    if (harmonic > SAMPLE_FREQ / 2.0)
+      harmonic = SAMPLE_FREQ - harmonic;
+    int b = band(harmonic);
+    if (n == 1)
+      fundamental = bn * bn / 2.0;
+    if (b < 0)
+      continue;
+    energy[b] += bn * bn / 2.0;
+    total += bn * bn / 2.0;
+    if (!resolved(harmonic, b)) {
+      for (int i = b - 1; i <= b + 1; i++) {
+        if (i >= 0 && i < BANDS && spoiled[i] < bn * bn / 2.0)
+          spoiled[i] = bn * bn / 2.0;
+      }
+    }
+  }
+  for (int b = 0; b < BANDS; b++) {
+    if (energy[b] >= fundamental * pow(10.0, -CLIP_RANGE / 10.0) && spoiled[b] < 0.01 * energy[b])
+      check(test, name("band %.0f Hz", bands[b].centre), levels.lz.spectrum[b], level(energy[b]), TONE_TOLERANCE);
+  }
+  check(test, "LZ", levels.lz.avg, level(total), TOTAL_TOLERANCE);
+}
+
+// the fixed point FFT against the float FFT on the same frames, input as in integerToFloat and integerToFixed
+// without the DC removal and the gain, the octaves of the single FFT from 31.5 Hz, the fixed point energy in double
+static void fixedPoint(const std::string &title, const Signal &signal) {
+  static RealFft<SAMPLES> realFft;
+  static FixedRealFft<SAMPLES> fixedFft;
+  static float real[SAMPLES], hann[SAMPLES / 2];
+  static int32_t fixed[SAMPLES], hannQ30[SAMPLES / 2], words[SAMPLES];
+  static BandMap map;
+  if (map.bands == 0) {
+    arduinoFFT table(NULL, NULL, SAMPLES, SAMPLES);
+    const float *w = table.WindowTable(FFT_WIN_TYP_HANN);
+    for (int i = 0; i < SAMPLES / 2; i++) {
+      hann[i] = w[i];
+      hannQ30[i] = (int32_t)lround(w[i] * (1L << 30));
+    }
+    map.octaves(2, LAST_OCTAVE);
+  }
+
+  SignalGenerator generator(signal, SAMPLE_FREQ);
+  double floatEnergy[MAX_BANDS] = { 0.0 }, fixedEnergy[MAX_BANDS] = { 0.0 };
+  Levels levels;
+  levels.frames = FIXED_FRAMES;
+  levels.seconds = 0.0;
+  for (int k = 0; k < FIXED_FRAMES; k++) {
+    generator.read(words, SAMPLES);
+    for (int i = 0; i < SAMPLES; i++) {
+      int32_t a = words[i] >> 8;
+      int w = (i < SAMPLES / 2) ? i : SAMPLES - 1 - i;
+      real[i] = a * hann[w];
+      fixed[i] = (int32_t)(((int64_t)a * (1 << FIXED_PRESHIFT) * hannQ30[w]) >> 30);
+    }
+    realFft.forward(real);
+    double start = seconds();
+    int8_t exponent = fixedFft.forward(fixed);
+    levels.seconds += seconds() - start;
+    double scale = ldexp(1.0, exponent - FIXED_PRESHIFT);
+    for (int b = 0; b < map.bands; b++) {
+      for (int bin = map.first[b]; bin <= map.last[b]; bin++) {
+        floatEnergy[b] += sq((double)real[2 * bin]) + sq((double)real[2 * bin + 1]);
+        fixedEnergy[b] += sq(fixed[2 * bin] * scale) + sq(fixed[2 * bin + 1] * scale);
+      }
+    }
+  }
+
+  Test &test = begin(title, levels);
+  test.dsp = false;                 // the time of the fixed point FFT alone
+  double strongest = 0.0;
+  for (int b = 0; b < map.bands; b++)
+    strongest = fmax(strongest, floatEnergy[b]);
+  for (int b = 0; b < map.bands; b++) {
+    std::string what = name("fixed point band %.0f Hz", 1000.0 * pow(2.0, b - 5));
+    if (decibel(floatEnergy[b]) >= decibel(strongest) - FIXED_RANGE)
+      check(test, what, decibel(fixedEnergy[b]), decibel(floatEnergy[b]), FIXED_TOLERANCE);
+    else if (verbose)
+      printf("  %-4s %-40s %8.2f dB, float %8.2f dB, %+6.2f dB\n", "-", what.c_str(), decibel(fixedEnergy[b]),
+             decibel(floatEnergy[b]), decibel(fixedEnergy[b]) - decibel(floatEnergy[b]));
+  }
+}
+
+// the fixed point FFT at the levels of the sensor, down to the noise floor of the microphone
+static void fixedPoint() {
+  double f = round(1000.0 / binWidth) * binWidth;
+  fixedPoint("fixed point FFT, white noise", whiteNoise(amplitude(LEVEL)));
+  fixedPoint("fixed point FFT, white noise at -80 dBFS", whiteNoise(amplitude(-80.0)));
+  fixedPoint("fixed point FFT, pink noise", pinkNoise(amplitude(LEVEL)));
+  for (int dB = 0; dB >= -80; dB -= 40)
+    fixedPoint(name("fixed point FFT, sine 1 kHz at %.0f dBFS", dB), sine(f, amplitude(dB)));
+}
+
+int main(int argc, char *argv[]) {
+  const char *record = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--verbose") == 0)
+      verbose = true;
+    else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+      record = argv[++i];
+    else {
+      printf("usage: %s [--verbose] [--record file]\n", argv[0]);
+      return 2;
+    }
+  }
+  printf("DSP conformance, %u samples at %u Hz, %d bands, options %s\n\n", SAMPLES, SAMPLE_FREQ, BANDS, OPTIONS);
+  edges();
+  tones();
+  linearity();
+  offset();
+  sweeps();
+  noise();
+  bursts();
+  silence();
+  clipping();
+  fixedPoint();
+
+  int checks = 0, failed = 0;
+  double worst = 0.0, busy = 0.0;
+  uint32_t total = 0;
+  printf("\n%-40s %6s %6s %8s %8s %10s\n", "signal", "checks", "failed", "worst", "frames", "ns/frame");
+  for (size_t i = 0; i < tests.size(); i++) {
+    const Test &test = tests[i];
+    printf("%-40s %6d %6d %5.2f dB %8u %10.0f\n", test.name.c_str(), test.checks, test.failed, test.worst,
+           test.frames, test.seconds * 1e9 / test.frames);
+    checks += test.checks;
+    failed += test.failed;
+    if (test.worst > worst)
+      worst = test.worst;
+    if (test.dsp) {
+      busy += test.seconds;
+      total += test.frames;
+    }
+  }
+  double ns = busy * 1e9 / total;
+  double speed = total * frameTime / busy;
+  printf("\n%d checks, %d failed, worst deviation %.2f dB, %.0f ns per frame, %.0f times real time\n",
+         checks, failed, worst, ns, speed);
+  if (record != NULL) {
+    FILE *f = fopen(record, "a");
+    if (f == NULL) {
+      printf("cannot write %s\n", record);
+      return 2;
+    }
+    fprintf(f, "%s %d %d %.2f %.0f %.0f\n", OPTIONS, checks, failed, worst, ns, speed);
+    fclose(f);
+  }
+  return (failed == 0) ? 0 : 1;
+}
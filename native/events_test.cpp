@@ -0,0 +1,130 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file events_test.cpp
+ * \brief Test of the events of the LoRa core, events.h on the host event group.
+ *
+ * Three host threads play the tasks of the device. The audio thread sets FRAME_READY
+ * every FRAME_TIME. The LMIC thread plays a send request: it waits a random time up
+ * to REQUEST_TIME, sets TX_COMPLETE as the LMIC callback does, and starts the next
+ * request when the loop has handled the previous one, there is one request at a time on
+ * the device too. The main thread runs the loop of main.cpp: take the events, handle
+ * them, sleep in waitEvents() for at most IDLE_TIME.
+ *
+ * Checked: every TX_COMPLETE is handled once, an event set while the loop is busy is not
+ * lost, the time from setting an event to its handling stays below LATENCY_LIMIT, and the
+ * loop wakes up about once per event, it does not spin. The wake-ups, the idle time
+ * outs and the latencies are printed.
+ *
+ * usage: events_test [--requests count], exit code 1 on a failed check
+ */
+
+#include <Arduino.h>
+#include <atomic>
+#include <thread>
+#include "events.h"
+
+#define REQUESTS 200                ///< send requests of the LMIC thread
+#define FRAME_TIME 2                ///< ms between frames, faster than the device to have more events
+#define REQUEST_TIME 20             ///< ms, longest time of a request
+#define IDLE_TIME 100               ///< ms, longest sleep of the loop, as loraIdleTime( 100)
+#define LATENCY_LIMIT 50000         ///< us, a host thread may wait for a time slice of a loaded host
+
+static EventGroupHandle_t events;
+static std::atomic<bool> done( false);
+static std::atomic<uint32_t> frames( 0);        ///< set by the audio thread
+static std::atomic<uint32_t> frameTime( 0);     ///< micros() of the last FRAME_READY
+static std::atomic<uint32_t> completed( 0);     ///< TX_COMPLETE set by the LMIC thread
+static std::atomic<uint32_t> handled( 0);       ///< TX_COMPLETE handled by the loop
+static std::atomic<uint32_t> completeTime( 0);  ///< micros() of the last TX_COMPLETE
+
+struct Latency {
+  uint32_t count, max;
+  uint64_t sum;
+  void add(uint32_t us) { count++; sum += us; max = (us > max) ? us : max; }
+};
+
+int main(int argc, char *argv[]) {
+  uint32_t requests = REQUESTS;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--requests") == 0 && i + 1 < argc)
+      requests = strtoul(argv[++i], NULL, 10);
+    else {
+      printf("usage: %s [--requests count]\n", argv[0]);
+      return 2;
+    }
+  }
+  events = xEventGroupCreate();
+
+  std::thread audio([] {
+    while (!done) {
+      delay(FRAME_TIME);
+      frameTime = micros();
+      frames++;
+      xEventGroupSetBits(events, FRAME_READY);
+    }
+  });
+  std::thread lmic([requests] {
+    uint32_t state = 2463534242u;
+    for (uint32_t r = 0; r < requests; r++) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      delay(state % REQUEST_TIME);
+      completeTime = micros();
+      completed++;
+      xEventGroupSetBits(events, TX_COMPLETE);
+      while (handled < completed && !done)   // the loop starts the next request
+        std::this_thread::yield();
+    }
+  });
+
+  // the loop of core 1
+  Latency frameLatency = { 0, 0, 0 }, txLatency = { 0, 0, 0 };
+  uint32_t passes = 0, timeouts = 0, duplicates = 0, consumed = 0;
+  uint32_t start = millis();
+  while (handled < requests && millis() - start < 10 * requests * REQUEST_TIME) {
+    passes++;
+    EventBits_t bits = takeEvents(events);
+    uint32_t now = micros();
+    if (bits == 0)
+      timeouts++;
+    if (bits & FRAME_READY) {
+      frameLatency.add(now - frameTime);
+      consumed = frames;
+    }
+    if (bits & TX_COMPLETE) {
+      txLatency.add(now - completeTime);
+      if (handled == completed)
+        duplicates++;
+      handled = completed.load();
+    }
+    waitEvents(events, IDLE_TIME);
+  }
+  done = true;
+  audio.join();
+  lmic.join();
+
+  // a pass per frame and per request at most, a spinning loop makes far more
+  uint32_t set = frames + completed + timeouts;
+  bool pass = handled == requests && duplicates == 0 && txLatency.max < LATENCY_LIMIT &&
+              frameLatency.max < LATENCY_LIMIT && passes <= set + 1;
+  printf("%u requests, %u handled, %u twice, TX_COMPLETE latency avg=%u max=%u us\n", requests, (uint32_t)handled,
+         duplicates, txLatency.count ? (uint32_t)(txLatency.sum / txLatency.count) : 0, txLatency.max);
+  printf("%u frames, %u consumed, FRAME_READY latency avg=%u max=%u us\n", (uint32_t)frames, consumed,
+         frameLatency.count ? (uint32_t)(frameLatency.sum / frameLatency.count) : 0, frameLatency.max);
+  printf("%u loop passes for %u events, %u idle time outs%s\n", passes, set, timeouts, pass ? "" : ", FAILED");
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file framequeue_test.cpp
+ * \brief Stress test of the FrameQueue between two host threads.
+ *
+ * A producer thread pushes AudioFrame records with consecutive sequence numbers, when the
+ * queue is full it yields and tries the same record again, so no record is dropped. A
+ * consumer thread pops them and checks that the sequence numbers follow each other without
+ * gaps or duplicates, and that all fields of a record belong to its sequence number, a record
+ * read while it is written would mix two of them. The queue of the device, 16 frames, and a
+ * queue of 2 frames, where the threads meet at every item, are tested in turn.
+ *
+ * On x86 a missing acquire or release shows up as a torn record only rarely, the test is
+ * meant to run under ThreadSanitizer too, -fsanitize=thread in the build flags.
+ *
+ * usage: framequeue_test [--frames count], exit code 1 on a bad record
+ */
+
+#include <Arduino.h>
+#include <thread>
+#include "framequeue.h"
+
+#define FRAMES 2000000              ///< records per queue size
+
+// the value of every field follows from the sequence number, below 2^24 so the floats are exact
+static void fill(AudioFrame &frame, uint32_t seq) {
+  frame.seq = seq;
+  frame.time = ~seq;
+  for (int i = 0; i < BANDS; i++)
+    frame.energy[i] = (float)((seq & 0xFFFF) * MAX_BANDS + i);
+#ifdef IIR_FILTERS
+  for (int i = 0; i < WEIGHTED_CURVES; i++)
+    frame.weighted[i] = (float)((seq & 0xFFFF) * MAX_BANDS + BANDS + i);
+#endif
+}
+
+static bool intact(const AudioFrame &frame) {
+  AudioFrame expected;
+  fill(expected, frame.seq);
+  return memcmp(&frame, &expected, sizeof(frame)) == 0;
+}
+
+template <uint16_t N>
+static int stress(uint32_t count) {
+  static FrameQueue<AudioFrame, N> queue;
+  uint32_t full = 0;
+  std::thread producer([&full, count] {
+    AudioFrame frame;
+    for (uint32_t seq = 0; seq < count; seq++) {
+      fill(frame, seq);
+      while (!queue.push(frame)) {
+        full++;
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint32_t expected = 0, gaps = 0, duplicates = 0, torn = 0, empty = 0;
+  AudioFrame frame;
+  while (expected < count) {
+    if (!queue.pop(frame)) {
+      empty++;
+      std::this_thread::yield();
+      continue;
+    }
+    if (!intact(frame))
+      torn++;
+    else if (frame.seq < expected)
+      duplicates++;
+    else {
+      if (frame.seq > expected)
+        gaps++;
+      expected = frame.seq + 1;
+    }
+  }
+  producer.join();
+  int errors = gaps + duplicates + torn + (queue.size() != 0);
+  printf("queue of %2u: %u records, %u gaps, %u duplicates, %u torn, %u left, producer found it full %u times, consumer empty %u times%s\n",
+         N, count, gaps, duplicates, torn, queue.size(), full, empty, (errors > 0) ? ", FAILED" : "");
+  return errors;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t count = FRAMES;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+      count = strtoul(argv[++i], NULL, 10);
+    else {
+      printf("usage: %s [--frames count]\n", argv[0]);
+      return 2;
+    }
+  }
+  int errors = stress<16>(count);
+  errors += stress<2>(count);
+  return (errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file i2s.cpp
+ * \brief Host stand-in for the ESP32 I2S driver, samples from a source function.
+ *
+ * The default source is white noise from a fixed seed, about 30 dB below full scale,
+ * so every run processes the same samples.
+ */
+
+#include <driver/i2s.h>
+
+static I2sSource source = NULL;
+static QueueHandle_t events = NULL;   ///< event queue of the sound sensor
+static size_t bufferLength = 0;       ///< samples per DMA buffer
+static size_t buffered = 0;           ///< samples read from the current DMA buffer
+
+// xorshift noise in the upper 24 bits, uniform at +-2^18 of +-2^23
+static void noise(int32_t *samples, size_t count) {
+  static uint32_t state = 2463534242u;
+  for (size_t i = 0; i < count; i++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    samples[i] = (int32_t)(state & 0xfff80000) >> 5;
+  }
+}
+
+void i2sSource(I2sSource s) {
+  source = s;
+}
+
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t *config, int queueSize, void *queue) {
+  (void)port;
+  bufferLength = config->dma_buf_len;
+  buffered = 0;
+  events = NULL;
+  if (queue != NULL && queueSize > 0) {
+    events = xQueueCreate(queueSize, sizeof(i2s_event_t));
+    *(QueueHandle_t *)queue = events;
+  }
+  return ESP_OK;
+}
+
+esp_err_t i2s_driver_uninstall(i2s_port_t port) {
+  (void)port;
+  return ESP_OK;
+}
+
+esp_err_t i2s_set_pin(i2s_port_t port, const i2s_pin_config_t *pins) {
+  (void)port;
+  (void)pins;
+  return ESP_OK;
+}
+
+esp_err_t i2s_start(i2s_port_t port) {
+  (void)port;
+  return ESP_OK;
+}
+
+esp_err_t i2s_stop(i2s_port_t port) {
+  (void)port;
+  return ESP_OK;
+}
+
+esp_err_t i2s_read(i2s_port_t port, void *dest, size_t size, size_t *bytesRead, TickType_t ticks) {
+  (void)port;
+  (void)ticks;
+  size_t count = size / sizeof(int32_t);
+  (source != NULL ? source : noise)((int32_t *)dest, count);
+  *bytesRead = count * sizeof(int32_t);
+  // one RX_DONE event per DMA buffer, dropped when the queue is full like from the interrupt
+  buffered += count;
+  while (bufferLength > 0 && buffered >= bufferLength) {
+    buffered -= bufferLength;
+    i2s_event_t event = { I2S_EVENT_RX_DONE, bufferLength * sizeof(int32_t) };
+    if (events != NULL)
+      xQueueSend(events, &event, 0);
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,76 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file Arduino.h
+ * \brief Host stand-in for the Arduino core of the ESP32, only what the DSP sources use.
+ *
+ * The native build compiles soundsensor.cpp and measurement.cpp unchanged, main.cpp,
+ * lora.cpp and oled.cpp stay on the device. Like the ESP32 core this header brings
+ * in FreeRTOS, the tasks are host threads.
+ */
+
+#ifndef __NATIVE_ARDUINO_H_
+#define __NATIVE_ARDUINO_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+typedef bool boolean;
+
+#define sq(x) ((x) * (x))
+
+/// \brief microseconds since an arbitrary start, wraps like on the device
+static inline uint32_t micros() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// \brief milliseconds since an arbitrary start
+static inline uint32_t millis() {
+  return micros() / 1000;
+}
+
+static inline void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+/// \brief the chip functions the sources use, the host has no cycle counter so it counts ns at 1000 MHz
+class EspClass {
+  public:
+    uint32_t getCycleCount() {
+      return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    uint32_t getCpuFreqMHz() { return 1000; }
+};
+static EspClass ESP __attribute__((unused));
+
+/// \brief the serial port is stdout, in the same buffer as printf
+class HardwareSerial {
+  public:
+    void begin(unsigned long baud) { (void)baud; }
+    size_t write(const uint8_t *data, size_t size) { return fwrite(data, 1, size, stdout); }
+};
+static HardwareSerial Serial __attribute__((unused));
+
+#endif // __NATIVE_ARDUINO_H_
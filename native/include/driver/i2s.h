@@ -0,0 +1,108 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file i2s.h
+ * \brief Host stand-in for the ESP32 I2S driver, only the receive side the sound sensor uses.
+ *
+ * i2s_read() never waits, it fills the buffer from a sample source, see i2sSource(). So
+ * the DSP runs as fast as the host allows. The driver posts an I2S_EVENT_RX_DONE event
+ * for each DMA buffer read, like the device does when it keeps up.
+ */
+
+#ifndef __NATIVE_I2S_H_
+#define __NATIVE_I2S_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef enum { I2S_NUM_0 = 0, I2S_NUM_1 = 1, I2S_NUM_MAX } i2s_port_t;
+
+typedef enum {
+  I2S_MODE_MASTER = 1,
+  I2S_MODE_SLAVE = 2,
+  I2S_MODE_TX = 4,
+  I2S_MODE_RX = 8,
+} i2s_mode_t;
+
+typedef enum {
+  I2S_BITS_PER_SAMPLE_16BIT = 16,
+  I2S_BITS_PER_SAMPLE_24BIT = 24,
+  I2S_BITS_PER_SAMPLE_32BIT = 32,
+} i2s_bits_per_sample_t;
+
+typedef enum {
+  I2S_CHANNEL_FMT_RIGHT_LEFT = 0,
+  I2S_CHANNEL_FMT_ALL_RIGHT,
+  I2S_CHANNEL_FMT_ALL_LEFT,
+  I2S_CHANNEL_FMT_ONLY_RIGHT,
+  I2S_CHANNEL_FMT_ONLY_LEFT,
+} i2s_channel_fmt_t;
+
+typedef enum {
+  I2S_COMM_FORMAT_I2S = 1,
+  I2S_COMM_FORMAT_I2S_MSB = 2,
+  I2S_COMM_FORMAT_I2S_LSB = 4,
+} i2s_comm_format_t;
+
+typedef enum {
+  I2S_EVENT_DMA_ERROR = 0,
+  I2S_EVENT_TX_DONE,
+  I2S_EVENT_RX_DONE,
+} i2s_event_type_t;
+
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+#define I2S_PIN_NO_CHANGE -1
+
+typedef struct {
+  i2s_mode_t            mode;
+  int                   sample_rate;
+  i2s_bits_per_sample_t bits_per_sample;
+  i2s_channel_fmt_t     channel_format;
+  i2s_comm_format_t     communication_format;
+  int                   intr_alloc_flags;
+  int                   dma_buf_count;
+  int                   dma_buf_len;
+  bool                  use_apll;
+} i2s_config_t;
+
+typedef struct {
+  int bck_io_num;
+  int ws_io_num;
+  int data_out_num;
+  int data_in_num;
+} i2s_pin_config_t;
+
+typedef struct {
+  i2s_event_type_t type;
+  size_t           size;
+} i2s_event_t;
+
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t *config, int queueSize, void *queue);
+esp_err_t i2s_driver_uninstall(i2s_port_t port);
+esp_err_t i2s_set_pin(i2s_port_t port, const i2s_pin_config_t *pins);
+esp_err_t i2s_start(i2s_port_t port);
+esp_err_t i2s_stop(i2s_port_t port);
+esp_err_t i2s_read(i2s_port_t port, void *dest, size_t size, size_t *bytesRead, TickType_t ticks);
+
+/// \brief fills count 32 bit I2S words, the sample in the upper 24 bits like the microphone
+typedef void (*I2sSource)(int32_t *samples, size_t count);
+
+/// \brief stand-in only: the source of the samples of i2s_read(), NULL for the default noise
+void i2sSource(I2sSource source);
+
+#endif // __NATIVE_I2S_H_
@@ -0,0 +1,82 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file event_groups.h
+ * \brief Host stand-in for FreeRTOS event groups, bits behind a mutex and a condition variable.
+ *
+ * A task that waits sleeps on the condition variable until the bits it waits for are
+ * set or the ticks have passed, like a task blocked on an event group on the device.
+ */
+
+#ifndef __NATIVE_EVENT_GROUPS_H_
+#define __NATIVE_EVENT_GROUPS_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "FreeRTOS.h"
+
+typedef uint32_t EventBits_t;
+
+struct EventGroupDefinition {
+  std::mutex              mutex;
+  std::condition_variable changed;    ///< bits were set
+  EventBits_t             bits;
+};
+typedef EventGroupDefinition *EventGroupHandle_t;
+
+static inline EventGroupHandle_t xEventGroupCreate() {
+  EventGroupHandle_t group = new EventGroupDefinition;
+  group->bits = 0;
+  return group;
+}
+
+/// \return the bits after setting
+static inline EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+  std::unique_lock<std::mutex> lock(group->mutex);
+  group->bits |= bits;
+  group->changed.notify_all();
+  return group->bits;
+}
+
+/// \return the bits before clearing
+static inline EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+  std::unique_lock<std::mutex> lock(group->mutex);
+  EventBits_t before = group->bits;
+  group->bits &= ~bits;
+  return before;
+}
+
+/// \return the bits when the wait ended, before they were cleared
+static inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                              BaseType_t waitForAll, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(group->mutex);
+  auto ready = [group, bits, waitForAll] {
+    return waitForAll ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+  };
+  bool set;
+  if (ticks == portMAX_DELAY) {
+    group->changed.wait(lock, ready);
+    set = true;
+  }
+  else
+    set = group->changed.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), ready);
+  EventBits_t result = group->bits;
+  if (set && clearOnExit)
+    group->bits &= ~bits;
+  return result;
+}
+
+#endif // __NATIVE_EVENT_GROUPS_H_
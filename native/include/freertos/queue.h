@@ -0,0 +1,93 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file queue.h
+ * \brief Host stand-in for FreeRTOS queues, a ring of fixed size items behind a mutex.
+ *
+ * Items are copied in and out like on the device. A counting semaphore is a queue of
+ * items of size 0, see semphr.h.
+ */
+
+#ifndef __NATIVE_QUEUE_H_
+#define __NATIVE_QUEUE_H_
+
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include "FreeRTOS.h"
+
+struct QueueDefinition {
+  std::mutex              mutex;
+  std::condition_variable changed;    ///< an item was added or removed
+  std::vector<uint8_t>    items;      ///< length * size bytes
+  UBaseType_t             length;     ///< capacity in items
+  UBaseType_t             size;       ///< bytes per item
+  UBaseType_t             head;       ///< oldest item
+  UBaseType_t             count;      ///< items waiting
+
+  // wait until ready() holds or the ticks have passed, false on a timeout
+  template <typename Ready>
+  bool wait(std::unique_lock<std::mutex> &lock, TickType_t ticks, Ready ready) {
+    if (ticks == portMAX_DELAY) {
+      changed.wait(lock, ready);
+      return true;
+    }
+    return changed.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), ready);
+  }
+};
+typedef QueueDefinition *QueueHandle_t;
+
+static inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t size) {
+  QueueHandle_t queue = new QueueDefinition;
+  queue->items.resize(length * size);
+  queue->length = length;
+  queue->size = size;
+  queue->head = 0;
+  queue->count = 0;
+  return queue;
+}
+
+static inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!queue->wait(lock, ticks, [queue] { return queue->count < queue->length; }))
+    return pdFALSE;
+  UBaseType_t tail = (queue->head + queue->count) % queue->length;
+  if (item != NULL)               // a semaphore has no item
+    memcpy(&queue->items[tail * queue->size], item, queue->size);
+  queue->count++;
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+static inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (!queue->wait(lock, ticks, [queue] { return queue->count > 0; }))
+    return pdFALSE;
+  if (item != NULL)               // a semaphore has no item
+    memcpy(item, &queue->items[queue->head * queue->size], queue->size);
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+static inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  return queue->count;
+}
+
+#endif // __NATIVE_QUEUE_H_
@@ -0,0 +1,41 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file semphr.h
+ * \brief Host stand-in for FreeRTOS counting semaphores, a queue of empty items.
+ */
+
+#ifndef __NATIVE_SEMPHR_H_
+#define __NATIVE_SEMPHR_H_
+
+#include "queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+  SemaphoreHandle_t semaphore = xQueueCreate(maxCount, 0);
+  semaphore->count = initialCount;
+  return semaphore;
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+  return xQueueReceive(semaphore, NULL, ticks);
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  return xQueueSend(semaphore, NULL, 0);
+}
+
+#endif // __NATIVE_SEMPHR_H_
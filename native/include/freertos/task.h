@@ -0,0 +1,51 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file task.h
+ * \brief Host stand-in for FreeRTOS tasks, each task is a detached thread.
+ *
+ * Priorities and cores are ignored, the host scheduler decides. A task never returns
+ * on the device, so there is no way to delete one.
+ */
+
+#ifndef __NATIVE_TASK_H_
+#define __NATIVE_TASK_H_
+
+#include <chrono>
+#include <thread>
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+static inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth,
+                                                 void *parameter, UBaseType_t priority, TaskHandle_t *handle,
+                                                 BaseType_t core) {
+  (void)name;
+  (void)stackDepth;
+  (void)priority;
+  (void)core;
+  std::thread thread(task, parameter);
+  if (handle)
+    *handle = (TaskHandle_t)(uintptr_t)1;     // no handle to use, only not NULL
+  thread.detach();
+  return pdPASS;
+}
+
+static inline void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+#endif // __NATIVE_TASK_H_
@@ -0,0 +1,204 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file measurement_test.cpp
+ * \brief Test of the float sums of Measurement and WeightingBank over intervals of hours.
+ *
+ * The band energies of synthetic frames, at the frame rate of the build, are summed up
+ * in one interval of up to HOURS hours, by Measurement::update() for the A curve and by a
+ * WeightingBank for A, C and Z. Next to them a double sum of the same weighted energies is
+ * the reference. The avg and the spectrum of every curve must agree with it within
+ * TOLERANCE dB in intervals of 1, 4 and HOURS hours. A plain float sum of the A energies is
+ * printed for comparison, that is what the Kahan compensation saves: over a day of steady
+ * noise the plain sum is 0.009 dB off at 11 frames/s and 0.026 dB at 22 frames/s with
+ * OVERLAP_FRAMES, within an hour it is below 0.0001 dB. The compensated sums stay below
+ * 0.0001 dB. TOLERANCE is between the two, and in an interval of HOURS the plain sum must
+ * be off by more than TOLERANCE, or the test could not tell a plain float sum and fails.
+ * The bank counts the min, max, statistical and time weighted levels per curve itself, for
+ * the A curve they must be those of Measurement::update().
+ *
+ * The signals: steady noise, a quiet background of 30 dB with bursts of 100 dB, 1 s in
+ * every 10 s, where the background is 70 dB below the sum, and levels from 20 to 110 dB
+ * at random per band and frame.
+ *
+ * usage: measurement_test [--hours h], exit code 1 on a failed check
+ */
+
+#include <Arduino.h>
+#include "soundsensor.h"
+#include "measurement.h"
+
+#define HOURS 24                    ///< longest interval, a day
+#define TOLERANCE 0.001             ///< dB, a tenth of the error of a plain float sum over HOURS
+#define CURVES 3                    ///< A, C and Z
+
+static const double frameRate = (double)SAMPLE_FREQ / BLOCK_SIZE;
+
+static uint32_t state = 2463534242u;
+
+// xorshift, uniform in [0, 1)
+static double uniform() {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state / 4294967296.0;
+}
+
+static float energy(double dB) {
+  return (float)pow(10.0, dB / 10.0);
+}
+
+typedef void (*Signal)(uint32_t frame, float *energies);
+
+static void steady(uint32_t frame, float *energies) {
+  (void)frame;
+  for (int i = 0; i < BANDS; i++)
+    energies[i] = energy(60.0 + 0.5 * uniform());
+}
+
+static void bursts(uint32_t frame, float *energies) {
+  bool burst = fmod(frame / frameRate, 10.0) < 1.0;
+  for (int i = 0; i < BANDS; i++)
+    energies[i] = energy((burst ? 100.0 : 30.0) + 0.5 * uniform());
+}
+
+static void levels(uint32_t frame, float *energies) {
+  (void)frame;
+  for (int i = 0; i < BANDS; i++)
+    energies[i] = energy(20.0 + 90.0 * uniform());
+}
+
+/// \brief double sums of the weighted energies of one curve
+struct Reference {
+  double spectrum[MAX_BANDS];
+  double sum;
+  float plain;                      ///< float sum without compensation
+};
+
+static double decibel(double energy) {
+  return 10.0 * log10(energy);
+}
+
+static int check(const char *title, const Measurement::Result &r, const Reference &ref, uint32_t n, double *worst) {
+  int failed = 0;
+  double error = fabs(r.avg - decibel(ref.sum / n));
+  *worst = fmax(*worst, error);
+  failed += error > TOLERANCE;
+  for (int i = 0; i < BANDS; i++) {
+    double e = fabs(r.spectrum[i] - decibel(ref.spectrum[i] / n));
+    *worst = fmax(*worst, e);
+    failed += e > TOLERANCE;
+  }
+  if (failed > 0)
+    printf("  %s: avg %.3f dB, reference %.3f dB, %d values off\n", title, r.avg, decibel(ref.sum / n), failed);
+  return failed;
+}
+
+// the levels of one measurement, these are not summed up, so the bank must give the same as update()
+static int same(const char *title, const Measurement::Result &r, const Measurement::Result &ref) {
+  const float values[] = { r.min, r.max, r.l5, r.l10, r.l50, r.l90, r.l95, r.fmax, r.smax, r.imax };
+  const float refs[] = { ref.min, ref.max, ref.l5, ref.l10, ref.l50, ref.l90, ref.l95, ref.fmax, ref.smax, ref.imax };
+  int failed = 0;
+  for (unsigned i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    failed += fabs(values[i] - refs[i]) > TOLERANCE;
+  if (failed > 0)
+    printf("  %s: %d levels differ from update(), L50 %.3f dB, Fmax %.3f dB\n", title, failed, r.l50, r.fmax);
+  return failed;
+}
+
+// one interval of the hours, the weighting tables are converted in place by the curves, so they are local
+// \param [out] plain error of the plain float sum of the A energies in dB
+static int test(const char *name, Signal signal, uint32_t hours, double *plain) {
+  float aweighting[] = A_WEIGHTING;
+  float cweighting[] = C_WEIGHTING;
+  float zweighting[] = Z_WEIGHTING;
+  float singleWeighting[] = A_WEIGHTING;
+  WeightingCurve a(aweighting + FIRST_WEIGHTING, BANDS);
+  WeightingCurve c(cweighting + FIRST_WEIGHTING, BANDS);
+  WeightingCurve z(zweighting + FIRST_WEIGHTING, BANDS);
+  Measurement single(singleWeighting + FIRST_WEIGHTING, BANDS);   // A, summed up by update()
+  WeightingCurve *curves[CURVES] = { &a, &c, &z };
+  WeightingBank bank(BANDS);
+  for (int k = 0; k < CURVES; k++)
+    bank.add(curves[k]);
+
+  Reference refs[CURVES];
+  memset(refs, 0, sizeof(refs));
+  float energies[MAX_BANDS];
+  uint32_t n = (uint32_t)(hours * 3600 * frameRate);
+  state = 2463534242u;
+  for (uint32_t frame = 0; frame < n; frame++) {
+    signal(frame, energies);
+    bank.update(energies);
+    single.update(energies);
+    for (int k = 0; k < CURVES; k++) {
+      const float *w = curves[k]->weighting();
+      float sum = 0.0;
+      for (int i = 0; i < BANDS; i++) {
+        float v = energies[i] * w[i];
+        refs[k].spectrum[i] += v;
+        refs[k].sum += v;
+        sum += v;
+      }
+      refs[k].plain += sum;
+    }
+  }
+  bank.calculate();
+  single.calculate();
+
+  double worst = 0.0;
+  int failed = check("A update", single.result(), refs[0], n, &worst);
+  static const char *titles[CURVES] = { "A bank", "C bank", "Z bank" };
+  for (int k = 0; k < CURVES; k++)
+    failed += check(titles[k], curves[k]->result(), refs[k], n, &worst);
+  failed += same(titles[0], a.result(), single.result());
+  *plain = decibel(refs[0].plain / n) - decibel(refs[0].sum / n);
+  printf("%-7s %u h, %7u frames: LAeq %6.2f dB, worst error %.4f dB, plain float sum %+.4f dB%s\n", name, hours, n,
+         decibel(refs[0].sum / n), worst, *plain, (failed > 0) ? ", FAILED" : "");
+  return failed;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t hours = HOURS;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc)
+      hours = strtoul(argv[++i], NULL, 10);
+    else {
+      printf("usage: %s [--hours h]\n", argv[0]);
+      return 2;
+    }
+  }
+  printf("%.1f frames/s, tolerance %.3f dB\n", frameRate, TOLERANCE);
+  const uint32_t intervals[] = { 1, 4, hours };
+  int failed = 0;
+  double plain = 0.0, e;        // largest error of the plain float sum in the last interval
+  for (int k = 0; k < 3; k++) {
+    if (k > 0 && intervals[k] <= intervals[k - 1])
+      continue;
+    plain = 0.0;
+    failed += test("steady", steady, intervals[k], &e);
+    plain = fmax(plain, fabs(e));
+    failed += test("bursts", bursts, intervals[k], &e);
+    plain = fmax(plain, fabs(e));
+    failed += test("levels", levels, intervals[k], &e);
+    plain = fmax(plain, fabs(e));
+  }
+  // the check must be able to fail a plain float sum
+  if (hours >= HOURS && plain <= TOLERANCE) {
+    printf("a plain float sum is within %.3f dB after %u h, the tolerance cannot tell it, FAILED\n", TOLERANCE, hours);
+    failed++;
+  }
+  return (failed == 0) ? 0 : 1;
+}
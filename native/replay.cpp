@@ -0,0 +1,300 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file replay.cpp
+ * \brief Replay of a raw capture or a WAV file through the DSP and the measurements of the sensor.
+ *
+ * The samples are served by the stand-in I2S driver, so they take the path of the device:
+ * the capture task, the ring of blocks, readSamples() with the DSP options of this build and
+ * the A, C and Z measurements as in main.cpp. The same input always gives the same bits.
+ *
+ * A capture is the byte stream of the serial port of a sensor built with RAW_CAPTURE, see
+ * capture.h. The frames hold the samples, the other bytes are the log of the device, printed
+ * with --log. A restart of the I2S in the capture restarts the sensor here, so an overlapped
+ * window is primed at the same block. The report lines of the device hold its results in bits,
+ * the replay calculates its results after the same number of frames and compares the bits,
+ * any difference gives exit code 1. For that the capture must start at boot and the build must
+ * have the DSP options of the device, the block size and the sample frequency are checked.
+ *
+ * Without reports of the device, a WAV file or a capture that did not start at boot, the
+ * results are printed every interval of audio. The rolling Leq runs on the audio time.
+ * The replay time and the DSP load are printed at the end, a build with DSP_PROFILE adds
+ * the profile of each stage, so a capture is also the workload to profile a DSP change.
+ *
+ * usage: replay [--interval seconds] [--log] file
+ */
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "soundsensor.h"
+#include "measurement.h"
+#include "rollingleq.h"
+#include "capture.h"
+#include "wav.h"
+
+#ifdef OVERLAP_FRAMES
+#define PRIMING 1                   ///< blocks the DSP receives before the first frame of a window
+#else
+#define PRIMING 0
+#endif
+
+/// \brief report line of the device
+struct Report {
+  uint32_t    frames;               ///< frames before the report
+  std::string line;
+};
+
+static MappedFile capture;
+static WavFile wav;
+static bool fromWav = false;
+static std::vector<int32_t> captured;   ///< samples of the capture, block after block
+static std::vector<uint8_t> flags;      ///< flags of each block of the capture
+static std::vector<Report> reports;     ///< report lines of the device, in order
+static size_t position = 0;             ///< next sample for the I2S driver, used by the capture task only
+
+static float aweighting[] = A_WEIGHTING;
+static float cweighting[] = C_WEIGHTING;
+static float zweighting[] = Z_WEIGHTING;
+static WeightingCurve aMeasurement( aweighting + FIRST_WEIGHTING, BANDS);
+static WeightingCurve cMeasurement( cweighting + FIRST_WEIGHTING, BANDS);
+static WeightingCurve zMeasurement( zweighting + FIRST_WEIGHTING, BANDS);
+static WeightingBank weightings( BANDS);
+static RollingLeq rollingLeq;
+
+static double seconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// sample source of the stand-in I2S driver, past the end the input is silent
+static void source(int32_t *samples, size_t count) {
+  if (fromWav)
+    wav.read(position, count, samples);
+  else {
+    for (size_t i = 0; i < count; i++)
+      samples[i] = (position + i < captured.size()) ? captured[position + i] : 0;
+  }
+  position += count;
+}
+
+// a line of the device log
+static void logLine(const std::string &text, bool log) {
+  static const std::string prefix = CAPTURE_REPORT " frames=";
+  if (text.compare(0, prefix.size(), prefix) == 0) {
+    Report report = { (uint32_t)strtoul(text.c_str() + prefix.size(), NULL, 10), text };
+    reports.push_back(report);
+  }
+  if (log)
+    printf("device: %s\n", text.c_str());
+}
+
+// split the capture in frames and log lines, a damaged frame is skipped as text
+static bool readCapture(bool log) {
+  const uint8_t *data = capture.data();
+  size_t size = capture.size();
+  std::string text;
+  uint32_t first = 0, expected = 0, missing = 0;
+  for (size_t i = 0; i < size; ) {
+    size_t length = (data[i] == CAPTURE_SYNC[0]) ? captureCheck(data + i, size - i) : 0;
+    if (length == 0) {
+      char c = data[i++];
+      if (c == '\n') {
+        logLine(text, log);
+        text.clear();
+      }
+      else if (c != '\r')
+        text += c;
+      continue;
+    }
+    const uint8_t *frame = data + i;
+    i += length;
+    uint16_t n = captureGet16(frame + 6);
+    uint32_t block = captureGet32(frame + 8);
+    uint32_t rate = captureGet32(frame + 12);
+    if (n != BLOCK_SIZE || rate != SAMPLE_FREQ) {
+      printf("block %u has %u samples at %u Hz, this build reads %u at %u Hz, build it with the DSP options of the device\n",
+             block, n, rate, BLOCK_SIZE, SAMPLE_FREQ);
+      return false;
+    }
+    if (flags.empty())
+      first = block;
+    else if (block != expected) {
+      printf("blocks %u .. %u are missing\n", expected, block - 1);
+      missing += block - expected;
+    }
+    expected = block + 1;
+    size_t at = captured.size();
+    captured.resize(at + n);
+    captureDecode(frame, &captured[at]);
+    flags.push_back(frame[5]);
+  }
+  if (!text.empty())
+    logLine(text, log);
+  if (flags.empty()) {
+    printf("no capture frames found\n");
+    return false;
+  }
+  printf("capture of %u blocks from block %u, %.1f s of audio, %u device reports\n",
+         (unsigned)flags.size(), first, (double)captured.size() / SAMPLE_FREQ, (unsigned)reports.size());
+  if (first != 0 && !reports.empty()) {
+    printf("the capture does not start at boot, the device reports are not compared\n");
+    reports.clear();
+  }
+  if (missing > 0)
+    printf("%u blocks are missing, the device reports after the first gap will differ\n", missing);
+  return true;
+}
+
+static void print(uint32_t frames, uint32_t ms) {
+  char line[CAPTURE_REPORT_SIZE];
+  printf("\nreport at %.1f s after %u frames\n", ms / 1000.0, frames);
+  printf("LA ");
+  aMeasurement.print();
+  printf("LC ");
+  cMeasurement.print();
+  printf("LZ ");
+  zMeasurement.print();
+  printf("LAeq");
+  for (int j = 0; j < ROLLING_WINDOWS; j++)
+    printf(" %u min=%.1f", RollingLeq::seconds(j) / 60, rollingLeq.leq(j));
+  printf("\n");
+  captureReport(line, frames, aMeasurement.result(), cMeasurement.result(), zMeasurement.result(), BANDS);
+  printf("%s\n", line);
+}
+
+// calculate after the frames of a device report and compare the bits
+static bool compare(const Report &report, uint32_t frames) {
+  char line[CAPTURE_REPORT_SIZE];
+  weightings.calculate();
+  captureReport(line, frames, aMeasurement.result(), cMeasurement.result(), zMeasurement.result(), BANDS);
+  bool identical = report.line == line;
+  printf("device report after %u frames: %s\n", frames, identical ? "identical" : "DIFFERENT");
+  if (!identical) {
+    printf("device %s\nreplay %s\n", report.line.c_str(), line);
+    print(frames, (uint64_t)frames * BLOCK_SIZE * 1000 / SAMPLE_FREQ);
+  }
+  return identical;
+}
+
+int main(int argc, char *argv[]) {
+  double interval = CYCLETIME;
+  bool log = false;
+  const char *file = NULL;
+  bool usage = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+      interval = atof(argv[++i]);
+    else if (strcmp(argv[i], "--log") == 0)
+      log = true;
+    else if (argv[i][0] != '-' && file == NULL)
+      file = argv[i];
+    else
+      usage = true;
+  }
+  if (usage || file == NULL || interval <= 0.0) {
+    printf("usage: %s [--interval seconds] [--log] capture or WAV file\n", argv[0]);
+    return 2;
+  }
+
+  if (!capture.open(file))
+    return 2;
+  size_t total;
+  if (WavFile::is(capture.data(), capture.size())) {
+    capture.close();
+    if (!wav.open(file))
+      return 2;
+    if (wav.rate() != SAMPLE_FREQ) {
+      printf("%s is sampled at %u Hz, the sensor at %u Hz, resample it first (sox %s -r %u out.wav)\n",
+             file, wav.rate(), SAMPLE_FREQ, file, SAMPLE_FREQ);
+      return 2;
+    }
+    fromWav = true;
+    total = wav.count();
+    printf("WAV file of %u bits, %u channel(s), %.1f s of audio, the first channel is used\n",
+           wav.bits(), wav.channels(), (double)total / SAMPLE_FREQ);
+  }
+  else {
+    if (!readCapture(log))
+      return 2;
+    total = captured.size();
+  }
+
+  // as Task0 and setup() of main.cpp
+  i2sSource(source);
+  static SoundSensor sensor;
+  sensor.begin();
+  sensor.offset( MIC_OFFSET);
+  sensor.start();
+  weightings.add( &aMeasurement);
+  weightings.add( &cMeasurement);
+  weightings.add( &zMeasurement);
+  weightings.frameTime( (float)BLOCK_SIZE / SAMPLE_FREQ);
+
+  size_t blocks = total / BLOCK_SIZE;
+  size_t block = 0;                 // next block the DSP receives
+  bool primed = false;              // the DSP holds the older half of an overlapped window
+  uint32_t frames = 0;
+  uint32_t reported = 0;            // audio time of the last report
+  uint32_t ms = 0;                  // audio time
+  size_t next = 0;                  // next device report
+  uint32_t identical = 0;
+  double start = seconds();
+  while (next < reports.size() && reports[next].frames == frames)
+    identical += compare(reports[next++], frames);
+  while (true) {
+    if (block > 0 && block < flags.size() && (flags[block] & CAPTURE_RESTART)) {
+      sensor.start();
+      primed = false;
+    }
+    size_t need = primed ? 1 : 1 + PRIMING;
+    if (block + need > blocks)
+      break;
+    float *energy = sensor.readSamples();
+    block += need;
+    primed = true;
+    frames++;
+    ms = (uint64_t)frames * BLOCK_SIZE * 1000 / SAMPLE_FREQ;
+#ifdef IIR_FILTERS
+    weightings.update( energy, sensor.weighted(), WEIGHTED_CURVES);
+#else
+    weightings.update( energy);
+#endif
+    rollingLeq.add( weightings.energy( 0), ms);
+    if (!reports.empty()) {
+      while (next < reports.size() && reports[next].frames == frames)
+        identical += compare(reports[next++], frames);
+    }
+    else if (ms - reported >= interval * 1000.0) {
+      weightings.calculate();
+      print(frames, ms);
+      reported = ms;
+    }
+  }
+  if (reports.empty() && ms > reported) {
+    weightings.calculate();
+    print(frames, ms);
+  }
+  double elapsed = seconds() - start;
+
+  printf("\nreplayed %u frames, %.1f s of audio in %.2f s, %.0f times real time\n",
+         frames, ms / 1000.0, elapsed, (elapsed > 0.0) ? ms / 1000.0 / elapsed : 0.0);
+  sensor.report();
+  if (reports.empty())
+    return 0;
+  if (next < reports.size())
+    printf("%u device reports after the last complete frame are not compared\n", (unsigned)(reports.size() - next));
+  printf("%u of %u device reports identical\n", identical, (unsigned)next);
+  return (identical == next) ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file signals.cpp
+ * \brief Synthetic test signals for the host tools, as I2S words of the microphone.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "signals.h"
+
+// pink noise filter of Paul Kellet, within 0.05 dB of -3 dB per octave from fs/4800 up,
+// six first order sections, a direct and a delayed path of the white noise
+static const double pinkPole[6] = { 0.99886, 0.99332, 0.96900, 0.86650, 0.55000, -0.7616 };
+static const double pinkGain[6] = { 0.0555179, 0.0750759, 0.1538520, 0.3104856, 0.5329522, -0.0168980 };
+#define PINK_DIRECT 0.5362
+#define PINK_DELAYED 0.115926
+
+static Signal make(SignalType type, float amplitude) {
+  Signal signal;
+  memset(&signal, 0, sizeof(signal));
+  signal.type = type;
+  signal.amplitude = amplitude;
+  signal.seed = 2463534242u;
+  return signal;
+}
+
+Signal sine(float frequency, float amplitude) {
+  Signal signal = make(SIGNAL_SINE, amplitude);
+  signal.frequency = frequency;
+  return signal;
+}
+
+Signal sweep(float from, float to, float sweepTime, float amplitude) {
+  Signal signal = make(SIGNAL_SWEEP, amplitude);
+  signal.frequency = from;
+  signal.to = to;
+  signal.sweepTime = sweepTime;
+  return signal;
+}
+
+Signal whiteNoise(float rms, uint32_t seed) {
+  Signal signal = make(SIGNAL_WHITE, rms);
+  signal.seed = seed;
+  return signal;
+}
+
+Signal pinkNoise(float rms, uint32_t seed) {
+  Signal signal = make(SIGNAL_PINK, rms);
+  signal.seed = seed;
+  return signal;
+}
+
+SignalGenerator::SignalGenerator(const Signal &signal, uint32_t rate) {
+  _signal = signal;
+  _rate = rate;
+  _n = 0;
+  _state = (signal.seed != 0) ? signal.seed : 1;
+  _spare = false;
+  _gaussian = 0.0;
+  memset(_pink, 0, sizeof(_pink));
+
+  // variance of the filter for unit white noise, each section is a first order recursion
+  // y = a * y + g * w, the covariance of two sections is g1 * g2 / (1 - a1 * a2)
+  double variance = PINK_DIRECT * PINK_DIRECT + PINK_DELAYED * PINK_DELAYED;
+  for (int i = 0; i < 6; i++) {
+    for (int j = 0; j < 6; j++)
+      variance += pinkGain[i] * pinkGain[j] / (1.0 - pinkPole[i] * pinkPole[j]);
+    variance += 2.0 * pinkGain[i] * (PINK_DIRECT + pinkPole[i] * PINK_DELAYED);
+  }
+  _pinkGain = 1.0 / sqrt(variance);
+}
+
+// xorshift and Box-Muller, two gaussians from a pair of uniforms
+double SignalGenerator::gaussian() {
+  if (_spare) {
+    _spare = false;
+    return _gaussian;
+  }
+  double u[2];
+  for (int k = 0; k < 2; k++) {
+    _state ^= _state << 13;
+    _state ^= _state >> 17;
+    _state ^= _state << 5;
+    u[k] = (_state + 0.5) / 4294967296.0;     // 0 < u < 1
+  }
+  double r = sqrt(-2.0 * log(u[0]));
+  _gaussian = r * sin(2.0 * M_PI * u[1]);
+  _spare = true;
+  return r * cos(2.0 * M_PI * u[1]);
+}
+
+double SignalGenerator::pink() {
+  double white = gaussian();
+  double sum = PINK_DIRECT * white + _pink[6];
+  for (int i = 0; i < 6; i++) {
+    _pink[i] = pinkPole[i] * _pink[i] + pinkGain[i] * white;
+    sum += _pink[i];
+  }
+  _pink[6] = PINK_DELAYED * white;
+  return sum * _pinkGain;
+}
+
+double SignalGenerator::next() {
+  double t = _n / _rate;
+  _n++;
+  double x = 0.0;
+  switch (_signal.type) {
+    case SIGNAL_SINE: {
+      double cycles = _signal.frequency * t;
+      x = _signal.amplitude * sin(2.0 * M_PI * (cycles - floor(cycles)));
+      break;
+    }
+    case SIGNAL_SWEEP: {
+      // f(t) = from * exp(t * l / T), the phase is its integral
+      double l = log(_signal.to / _signal.frequency);
+      double s = fmod(t, _signal.sweepTime);
+      double cycles = _signal.frequency * _signal.sweepTime / l * (exp(s * l / _signal.sweepTime) - 1.0);
+      x = _signal.amplitude * sin(2.0 * M_PI * (cycles - floor(cycles)));
+      break;
+    }
+    case SIGNAL_WHITE:
+      x = _signal.amplitude * gaussian();
+      break;
+    case SIGNAL_PINK:
+      x = _signal.amplitude * pink();
+      break;
+  }
+  if (_signal.burstOn > 0.0 && fmod(t, _signal.burstPeriod) >= _signal.burstOn)
+    x = 0.0;
+  x += _signal.offset;
+  if (_signal.clip > 0.0)
+    x = (x > _signal.clip) ? _signal.clip : (x < -_signal.clip) ? -_signal.clip : x;
+  return x;
+}
+
+void SignalGenerator::read(int32_t *samples, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    long s = lround(next() * 8388608.0);
+    s = (s > 8388607) ? 8388607 : (s < -8388608) ? -8388608 : s;
+    samples[i] = (int32_t)((uint32_t)s << 8);
+  }
+}
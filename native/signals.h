@@ -0,0 +1,85 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file signals.h
+ * \brief Synthetic test signals for the host tools, as I2S words of the microphone.
+ *
+ * A signal is a sine, a logarithmic sweep, white or pink noise, optionally gated
+ * into tone bursts, with a DC offset added and clipped at a level. All levels are
+ * fractions of full scale, the samples are produced one after the other and are
+ * the same for the same Signal, the noise comes from a fixed seed.
+ */
+
+#ifndef __NATIVE_SIGNALS_H_
+#define __NATIVE_SIGNALS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum SignalType {
+  SIGNAL_SINE,                      ///< sine at frequency
+  SIGNAL_SWEEP,                     ///< logarithmic sweep frequency .. to in sweepTime, repeated
+  SIGNAL_WHITE,                     ///< gaussian white noise
+  SIGNAL_PINK                       ///< gaussian noise filtered to -3 dB per octave
+};
+
+/// \brief description of a test signal
+struct Signal {
+  SignalType type;
+  float    amplitude;               ///< peak of a sine or sweep, rms of noise
+  float    frequency;               ///< in Hz, of the sine or the start of the sweep
+  float    to;                      ///< end of the sweep in Hz
+  float    sweepTime;               ///< duration of one sweep in s
+  float    burstOn;                 ///< on time of a burst in s, 0.0 for a continuous signal
+  float    burstPeriod;             ///< time from the start of a burst to the next in s
+  float    offset;                  ///< DC offset added to the signal
+  float    clip;                    ///< clip level, 0.0 for none, full scale always clips
+  uint32_t seed;                    ///< of the noise, not 0
+};
+
+/// \brief continuous sine, bursts, offset and clip can be set afterwards
+Signal sine(float frequency, float amplitude);
+Signal sweep(float from, float to, float sweepTime, float amplitude);
+Signal whiteNoise(float rms, uint32_t seed = 2463534242u);
+Signal pinkNoise(float rms, uint32_t seed = 2463534242u);
+
+/// \brief produces the samples of a Signal
+class SignalGenerator {
+  public:
+    /// \param [in] signal the signal
+    /// \param [in] rate sample frequency in Hz
+    SignalGenerator(const Signal &signal, uint32_t rate);
+
+    /// \brief next sample as a fraction of full scale, after offset and clip
+    double next();
+
+    /// \brief the next count samples as I2S words, the sample in the upper 24 bits
+    void read(int32_t *samples, size_t count);
+
+  private:
+    Signal   _signal;
+    double   _rate;
+    uint64_t _n;                    ///< samples produced
+    uint32_t _state;                ///< xorshift state of the noise
+    bool     _spare;                ///< the second gaussian of the last pair is unused
+    double   _gaussian;
+    double   _pink[7];              ///< state of the pink noise filter
+    double   _pinkGain;             ///< scales the filter to unit rms
+
+    double gaussian();
+    double pink();
+};
+
+#endif // __NATIVE_SIGNALS_H_
@@ -0,0 +1,149 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file wav.cpp
+ * \brief Memory mapped input files of the host tools, raw captures and WAV files.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "wav.h"
+
+#define WAV_PCM 1
+#define WAV_FLOAT 3
+#define WAV_EXTENSIBLE 0xFFFE
+
+static uint16_t get16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool MappedFile::open(const char *file) {
+  close();
+  int fd = ::open(file, O_RDONLY);
+  if (fd < 0) {
+    printf("cannot open %s\n", file);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    printf("%s is empty\n", file);
+    ::close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);                        // the map keeps the file
+  if (map == MAP_FAILED) {
+    printf("cannot map %s\n", file);
+    return false;
+  }
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+  _data = (uint8_t *)map;
+  _size = st.st_size;
+  return true;
+}
+
+void MappedFile::close() {
+  if (_data != NULL)
+    munmap(_data, _size);
+  _data = NULL;
+  _size = 0;
+}
+
+bool WavFile::is(const uint8_t *data, size_t size) {
+  return size >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0;
+}
+
+// the chunks after the RIFF header, the fmt chunk comes before the data chunk
+bool WavFile::open(const char *file) {
+  if (!_file.open(file))
+    return false;
+  const uint8_t *data = _file.data();
+  size_t size = _file.size();
+  if (!is(data, size)) {
+    printf("%s is not a WAV file\n", file);
+    return false;
+  }
+  _samples = NULL;
+  _format = 0;
+  for (size_t i = 12; i + 8 <= size; ) {
+    uint32_t length = get32(data + i + 4);
+    const uint8_t *chunk = data + i + 8;
+    size_t available = size - i - 8;
+    if (memcmp(data + i, "fmt ", 4) == 0 && length >= 16 && available >= 16) {
+      _format = get16(chunk);
+      _channels = get16(chunk + 2);
+      _rate = get32(chunk + 4);
+      _stride = get16(chunk + 12);
+      _bits = get16(chunk + 14);
+      if (_format == WAV_EXTENSIBLE && length >= 26 && available >= 26)
+        _format = get16(chunk + 24);    // the first bytes of the sub format GUID
+    }
+    else if (memcmp(data + i, "data", 4) == 0 && _format != 0) {
+      _samples = chunk;
+      if (length > available)
+        length = available;             // a recording that was not closed, or a size of 0xFFFFFFFF
+      _count = (_stride > 0) ? length / _stride : 0;
+      break;
+    }
+    i += 8 + length + (length & 1);     // chunks are padded to an even length
+  }
+  if (_samples == NULL) {
+    printf("%s has no fmt or data chunk\n", file);
+    return false;
+  }
+  bool pcm = _format == WAV_PCM && (_bits == 16 || _bits == 24 || _bits == 32);
+  bool real = _format == WAV_FLOAT && _bits == 32;
+  if ((!pcm && !real) || _channels == 0 || _stride < _channels * _bits / 8) {
+    printf("%s: format %u with %u bits is not supported, only PCM of 16, 24 or 32 bits or 32 bit float\n",
+           file, _format, _bits);
+    return false;
+  }
+  return true;
+}
+
+void WavFile::read(size_t first, size_t count, int32_t *samples) const {
+  for (size_t i = 0; i < count; i++) {
+    size_t n = first + i;
+    if (n >= _count) {
+      samples[i] = 0;
+      continue;
+    }
+    const uint8_t *p = _samples + n * _stride;
+    int32_t word;
+    if (_format == WAV_FLOAT) {
+      float v;
+      memcpy(&v, p, sizeof(v));
+      v = (v > 1.0f) ? 1.0f : (v < -1.0f) ? -1.0f : v;
+      int32_t s = lroundf(v * 8388608.0f);
+      word = (int32_t)((uint32_t)((s > 8388607) ? 8388607 : s) << 8);
+    }
+    else if (_bits == 16)
+      word = (int32_t)((uint32_t)get16(p) << 16);
+    else if (_bits == 24)
+      word = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24);
+    else
+      word = (int32_t)(get32(p) & 0xFFFFFF00);    // 24 bits, like the microphone
+    samples[i] = word;
+  }
+}
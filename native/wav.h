@@ -0,0 +1,83 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file wav.h
+ * \brief Memory mapped input files of the host tools, raw captures and WAV files.
+ *
+ * The file is mapped read only, so hours of audio are not read into memory and
+ * the samples are paged in when they are used. The WAV samples are converted to
+ * I2S words as the microphone delivers them, full scale of the WAV file is full
+ * scale of the 24 bit sample in the upper bits of the word.
+ */
+
+#ifndef __NATIVE_WAV_H_
+#define __NATIVE_WAV_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/// \brief read only memory map of a whole file
+class MappedFile {
+  public:
+    MappedFile() : _data(NULL), _size(0) {}
+    ~MappedFile() { close(); }
+
+    /// \brief map a file, prints the reason when it fails
+    bool open(const char *file);
+    void close();
+
+    const uint8_t *data() const { return _data; }
+    size_t size() const { return _size; }
+
+  private:
+    uint8_t *_data;
+    size_t   _size;
+
+    MappedFile(const MappedFile &);             // not copied, the map is unmapped once
+    MappedFile &operator=(const MappedFile &);
+};
+
+/// \brief WAV file of integer PCM of 16, 24 or 32 bits or of 32 bit float, only the first channel is used
+class WavFile {
+  public:
+    WavFile() : _samples(NULL), _format(0), _bits(0), _channels(0), _stride(0), _rate(0), _count(0) {}
+
+    /// \brief map and check a WAV file, prints the reason when it is not usable
+    bool open(const char *file);
+
+    /// \brief the data starts with a RIFF WAVE header
+    static bool is(const uint8_t *data, size_t size);
+
+    uint32_t rate() const { return _rate; }
+    uint16_t channels() const { return _channels; }
+    uint16_t bits() const { return _bits; }
+    size_t count() const { return _count; }     ///< samples per channel
+
+    /// \brief count samples of the first channel from first on as I2S words, the sample in the upper 24 bits
+    /// samples past the end are 0
+    void read(size_t first, size_t count, int32_t *samples) const;
+
+  private:
+    MappedFile     _file;
+    const uint8_t *_samples;           ///< first sample in the map
+    uint16_t       _format;            ///< 1 integer PCM, 3 float
+    uint16_t       _bits;              ///< bits per sample
+    uint16_t       _channels;
+    uint16_t       _stride;            ///< bytes per sample of all channels
+    uint32_t       _rate;              ///< sample frequency in Hz
+    size_t         _count;
+};
+
+#endif // __NATIVE_WAV_H_
@@ -0,0 +1,108 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file workpool.h
+ * \brief Work-stealing pool of host threads for independent tasks.
+ *
+ * The tasks 0 .. count-1 are dealt out in contiguous runs, one run per worker, so a
+ * worker reads its part of a file in order. A worker takes its own tasks from the
+ * front of its queue, when it runs out it steals from the back of the queue of
+ * another worker, the task that worker would reach last. No new tasks are added
+ * while the pool runs, so a worker that finds all queues empty is done.
+ */
+
+#ifndef __NATIVE_WORKPOOL_H_
+#define __NATIVE_WORKPOOL_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkPool {
+  public:
+    /// \brief a task, with the number of the worker that runs it
+    typedef std::function<void(size_t task, int worker)> Job;
+
+    /// \param [in] threads number of workers, 0 for the cores of the host
+    explicit WorkPool(int threads = 0) : _steals(0) {
+      if (threads <= 0)
+        threads = std::thread::hardware_concurrency();
+      _workers = (threads > 0) ? threads : 1;
+    }
+
+    int workers() const { return _workers; }
+
+    /// \brief tasks taken from another worker, in all runs
+    uint64_t steals() const { return _steals; }
+
+    /// \brief run job for the tasks 0 .. count-1, returns when all are done
+    void run(size_t count, const Job &job) {
+      std::vector<Queue> queues(_workers);
+      for (int w = 0; w < _workers; w++) {
+        size_t first = count * w / _workers;
+        size_t last = count * (w + 1) / _workers;
+        for (size_t task = first; task < last; task++)
+          queues[w].tasks.push_back(task);
+      }
+      std::vector<std::thread> threads;
+      for (int w = 0; w < _workers; w++) {
+        threads.push_back(std::thread([this, &queues, &job, w] {
+          size_t task;
+          while (next(queues, w, task))
+            job(task, w);
+        }));
+      }
+      for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    }
+
+  private:
+    struct Queue {
+      std::mutex         lock;
+      std::deque<size_t> tasks;
+    };
+
+    int _workers;
+    std::atomic<uint64_t> _steals;
+
+    // the next task of worker w, its own or a stolen one, false when there are none left
+    bool next(std::vector<Queue> &queues, int w, size_t &task) {
+      {
+        std::lock_guard<std::mutex> guard(queues[w].lock);
+        if (!queues[w].tasks.empty()) {
+          task = queues[w].tasks.front();
+          queues[w].tasks.pop_front();
+          return true;
+        }
+      }
+      for (int i = 1; i < _workers; i++) {
+        Queue &victim = queues[(w + i) % _workers];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+          task = victim.tasks.back();
+          victim.tasks.pop_back();
+          _steals++;
+          return true;
+        }
+      }
+      return false;
+    }
+};
+
+#endif // __NATIVE_WORKPOOL_H_
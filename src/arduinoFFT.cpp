@@ -28,11 +28,27 @@ arduinoFFT::arduinoFFT(float *vReal, float *vImag, uint16_t samples, float sampl
 	this->_samples = samples;
 	this->_samplingFrequency = samplingFrequency;
 	this->_power = Exponent(samples);
+	// Quarter wave sine table, all twiddle factors are derived from it
+	this->_sine = new float[(samples >> 2) + 1];
+	for (uint16_t k = 0; k <= (samples >> 2); k++) {
+		this->_sine[k] = sin((twoPi * k) / samples);
+	}
+	// Bit reversal swap lists and window are built on first use
+	for (uint8_t half = 0; half < 2; half++) {
+		this->_swaps[half] = NULL;
+		this->_swapCount[half] = 0;
+	}
+	this->_window = NULL;
+	this->_windowType = FFT_WIN_TYP_NONE;
 }
 
 arduinoFFT::~arduinoFFT(void)
 {
 // Destructor
+	delete[] this->_sine;
+	delete[] this->_swaps[0];
+	delete[] this->_swaps[1];
+	delete[] this->_window;
 }
 
 uint8_t arduinoFFT::Revision(void)
@@ -43,48 +59,37 @@ uint8_t arduinoFFT::Revision(void)
 void arduinoFFT::Compute(uint8_t dir)
 {// Computes in-place complex-to-complex FFT /
 	// Reverse bits /
-	uint16_t j = 0;
-	for (uint16_t i = 0; i < (this->_samples - 1); i++) {
-		if (i < j) {
-			Swap(&this->_vReal[i], &this->_vReal[j]);
-			if(dir==FFT_REVERSE)
-				Swap(&this->_vImag[i], &this->_vImag[j]);
-		}
-		uint16_t k = (this->_samples >> 1);
-		while (k <= j) {
-			j -= k;
-			k >>= 1;
-		}
-		j += k;
+	BuildSwaps(0);
+	const uint16_t *swaps = this->_swaps[0];
+	for (uint16_t s = 0; s < this->_swapCount[0]; s++) {
+		uint16_t i = swaps[2 * s];
+		uint16_t j = swaps[2 * s + 1];
+		Swap(&this->_vReal[i], &this->_vReal[j]);
+		if(dir==FFT_REVERSE)
+			Swap(&this->_vImag[i], &this->_vImag[j]);
 	}
 	// Compute the FFT  /
-	float c1 = -1.0;
-	float c2 = 0.0;
 	uint16_t l2 = 1;
 	for (uint8_t l = 0; (l < this->_power); l++) {
 		uint16_t l1 = l2;
 		l2 <<= 1;
-		float u1 = 1.0;
-		float u2 = 0.0;
-		for (j = 0; j < l1; j++) {
-			 for (uint16_t i = j; i < this->_samples; i += l2) {
-					uint16_t i1 = i + l1;
-					float t1 = u1 * this->_vReal[i1] - u2 * this->_vImag[i1];
-					float t2 = u1 * this->_vImag[i1] + u2 * this->_vReal[i1];
-					this->_vReal[i1] = this->_vReal[i] - t1;
-					this->_vImag[i1] = this->_vImag[i] - t2;
-					this->_vReal[i] += t1;
-					this->_vImag[i] += t2;
-			 }
-			 float z = ((u1 * c1) - (u2 * c2));
-			 u2 = ((u1 * c2) + (u2 * c1));
-			 u1 = z;
-		}
-		c2 = sqrt((1.0 - c1) / 2.0);
-		if (dir == FFT_FORWARD) {
-			c2 = -c2;
+		uint16_t step = this->_samples >> (l + 1);	// twiddle table stride for this stage
+		for (uint16_t j = 0; j < l1; j++) {
+			float u1, u2;
+			Twiddle(j * step, &u1, &u2);
+			if (dir != FFT_FORWARD) {
+				u2 = -u2;
+			}
+			for (uint16_t i = j; i < this->_samples; i += l2) {
+				uint16_t i1 = i + l1;
+				float t1 = u1 * this->_vReal[i1] - u2 * this->_vImag[i1];
+				float t2 = u1 * this->_vImag[i1] + u2 * this->_vReal[i1];
+				this->_vReal[i1] = this->_vReal[i] - t1;
+				this->_vImag[i1] = this->_vImag[i] - t2;
+				this->_vReal[i] += t1;
+				this->_vImag[i] += t2;
+			}
 		}
-		c1 = sqrt((1.0 + c1) / 2.0);
 	}
 	// Scaling for reverse transform /
 	if (dir != FFT_FORWARD) {
@@ -95,6 +100,66 @@ void arduinoFFT::Compute(uint8_t dir)
 	}
 }
 
+void arduinoFFT::ComputeReal()
+{// Computes in-place forward FFT of real data, vImag is not used /
+	// The samples real values are packed as samples/2 complex values (even index = Re,
+	// odd index = Im), transformed, and split into the samples/2+1 unique bins.
+	// Result: vReal[2k] = Re(X[k]), vReal[2k+1] = Im(X[k]) for k = 1 .. samples/2-1,
+	// vReal[0] = X[0] and vReal[1] = X[samples/2] (both purely real) /
+	float *v = this->_vReal;
+	uint16_t n = (this->_samples >> 1);
+	// Reverse bits /
+	BuildSwaps(1);
+	const uint16_t *swaps = this->_swaps[1];
+	for (uint16_t s = 0; s < this->_swapCount[1]; s++) {
+		uint16_t i = swaps[2 * s];
+		uint16_t j = swaps[2 * s + 1];
+		Swap(&v[2 * i], &v[2 * j]);
+		Swap(&v[2 * i + 1], &v[2 * j + 1]);
+	}
+	// Compute the half size complex FFT /
+	uint16_t l2 = 1;
+	for (uint8_t l = 0; (l < this->_power - 1); l++) {
+		uint16_t l1 = l2;
+		l2 <<= 1;
+		uint16_t step = this->_samples >> (l + 1);	// twiddle table stride for this stage
+		for (uint16_t j = 0; j < l1; j++) {
+			float u1, u2;
+			Twiddle(j * step, &u1, &u2);
+			for (uint16_t i = j; i < n; i += l2) {
+				uint16_t i1 = i + l1;
+				float t1 = u1 * v[2 * i1] - u2 * v[2 * i1 + 1];
+				float t2 = u1 * v[2 * i1 + 1] + u2 * v[2 * i1];
+				v[2 * i1] = v[2 * i] - t1;
+				v[2 * i1 + 1] = v[2 * i + 1] - t2;
+				v[2 * i] += t1;
+				v[2 * i + 1] += t2;
+			}
+		}
+	}
+	// Split the even and odd parts into the real spectrum /
+	// X[k] = Fe + W^k * Fo, X[n-k] = conj(Fe - W^k * Fo), W = exp(-2*pi*i/samples)
+	float r0 = v[0];
+	v[0] = r0 + v[1];		// DC
+	v[1] = r0 - v[1];		// Nyquist
+	for (uint16_t k = 1; k < (n >> 1); k++) {
+		uint16_t m = n - k;
+		float er = 0.5 * (v[2 * k] + v[2 * m]);
+		float ei = 0.5 * (v[2 * k + 1] - v[2 * m + 1]);
+		float or_ = 0.5 * (v[2 * k + 1] + v[2 * m + 1]);
+		float oi = -0.5 * (v[2 * k] - v[2 * m]);
+		float wr, wi;
+		Twiddle(k, &wr, &wi);
+		float tr = wr * or_ - wi * oi;
+		float ti = wr * oi + wi * or_;
+		v[2 * k] = er + tr;
+		v[2 * k + 1] = ei + ti;
+		v[2 * m] = er - tr;
+		v[2 * m + 1] = -(ei - ti);
+	}
+	v[n + 1] = -v[n + 1];	// k = samples/4, W^k = -i
+}
+
 void arduinoFFT::ComplexToMagnitude()
 { // vM is half the size of vReal and vImag
 	for (uint16_t i = 0; i < this->_samples; i++) {
@@ -121,44 +186,9 @@ void arduinoFFT::DCRemoval()
 void arduinoFFT::Windowing(uint8_t windowType, uint8_t dir)
 {// Weighing factors are computed once before multiple use of FFT
 // The weighing function is symetric; half the weighs are recorded
-	float samplesMinusOne = (float(this->_samples) - 1.0);
+	BuildWindow(windowType);
 	for (uint16_t i = 0; i < (this->_samples >> 1); i++) {
-		float indexMinusOne = float(i);
-		float ratio = (indexMinusOne / samplesMinusOne);
-		float weighingFactor = 1.0;
-		// Compute and record weighting factor
-		switch (windowType) {
-		case FFT_WIN_TYP_RECTANGLE: // rectangle (box car)
-			weighingFactor = 1.0;
-			break;
-		case FFT_WIN_TYP_HAMMING: // hamming
-			weighingFactor = 0.54 - (0.46 * cos(twoPi * ratio));
-			break;
-		case FFT_WIN_TYP_HANN: // hann
-			weighingFactor = 0.54 * (1.0 - cos(twoPi * ratio));
-			break;
-		case FFT_WIN_TYP_TRIANGLE: // triangle (Bartlett)
-			weighingFactor = 1.0 - ((2.0 * abs(indexMinusOne - (samplesMinusOne / 2.0))) / samplesMinusOne);
-			break;
-		case FFT_WIN_TYP_NUTTALL: // nuttall
-			weighingFactor = 0.355768 - (0.487396 * (cos(twoPi * ratio))) + (0.144232 * (cos(fourPi * ratio))) - (0.012604 * (cos(sixPi * ratio)));
-			break;
-		case FFT_WIN_TYP_BLACKMAN: // blackman
-			weighingFactor = 0.42323 - (0.49755 * (cos(twoPi * ratio))) + (0.07922 * (cos(fourPi * ratio)));
-			break;
-		case FFT_WIN_TYP_BLACKMAN_NUTTALL: // blackman nuttall
-			weighingFactor = 0.3635819 - (0.4891775 * (cos(twoPi * ratio))) + (0.1365995 * (cos(fourPi * ratio))) - (0.0106411 * (cos(sixPi * ratio)));
-			break;
-		case FFT_WIN_TYP_BLACKMAN_HARRIS: // blackman harris
-			weighingFactor = 0.35875 - (0.48829 * (cos(twoPi * ratio))) + (0.14128 * (cos(fourPi * ratio))) - (0.01168 * (cos(sixPi * ratio)));
-			break;
-		case FFT_WIN_TYP_FLT_TOP: // flat top
-			weighingFactor = 0.2810639 - (0.5208972 * cos(twoPi * ratio)) + (0.1980399 * cos(fourPi * ratio));
-			break;
-		case FFT_WIN_TYP_WELCH: // welch
-			weighingFactor = 1.0 - sq((indexMinusOne - samplesMinusOne / 2.0) / (samplesMinusOne / 2.0));
-			break;
-		}
+		float weighingFactor = this->_window[i];
 		if (dir == FFT_FORWARD) {
 			this->_vReal[i] *= weighingFactor;
 			this->_vReal[this->_samples - (i + 1)] *= weighingFactor;
@@ -170,6 +200,12 @@ void arduinoFFT::Windowing(uint8_t windowType, uint8_t dir)
 	}
 }
 
+const float *arduinoFFT::WindowTable(uint8_t windowType)
+{// Returns the first half of the weighing function, the second half is its mirror
+	BuildWindow(windowType);
+	return this->_window;
+}
+
 float arduinoFFT::MajorPeak()
 {
 	float maxY = 0;
@@ -225,6 +261,97 @@ uint8_t arduinoFFT::Exponent(uint16_t value)
 
 // Private functions
 
+void arduinoFFT::BuildWindow(uint8_t windowType)
+{// Records the first half of the weighing function, only when the window type changes
+	if (this->_window != NULL && this->_windowType == windowType) {
+		return;
+	}
+	if (this->_window == NULL) {
+		this->_window = new float[this->_samples >> 1];
+	}
+	this->_windowType = windowType;
+	float samplesMinusOne = (float(this->_samples) - 1.0);
+	for (uint16_t i = 0; i < (this->_samples >> 1); i++) {
+		float indexMinusOne = float(i);
+		float ratio = (indexMinusOne / samplesMinusOne);
+		float weighingFactor = 1.0;
+		// Compute and record weighting factor
+		switch (windowType) {
+		case FFT_WIN_TYP_RECTANGLE: // rectangle (box car)
+			weighingFactor = 1.0;
+			break;
+		case FFT_WIN_TYP_HAMMING: // hamming
+			weighingFactor = 0.54 - (0.46 * cos(twoPi * ratio));
+			break;
+		case FFT_WIN_TYP_HANN: // hann
+			weighingFactor = 0.54 * (1.0 - cos(twoPi * ratio));
+			break;
+		case FFT_WIN_TYP_TRIANGLE: // triangle (Bartlett)
+			weighingFactor = 1.0 - ((2.0 * abs(indexMinusOne - (samplesMinusOne / 2.0))) / samplesMinusOne);
+			break;
+		case FFT_WIN_TYP_NUTTALL: // nuttall
+			weighingFactor = 0.355768 - (0.487396 * (cos(twoPi * ratio))) + (0.144232 * (cos(fourPi * ratio))) - (0.012604 * (cos(sixPi * ratio)));
+			break;
+		case FFT_WIN_TYP_BLACKMAN: // blackman
+			weighingFactor = 0.42323 - (0.49755 * (cos(twoPi * ratio))) + (0.07922 * (cos(fourPi * ratio)));
+			break;
+		case FFT_WIN_TYP_BLACKMAN_NUTTALL: // blackman nuttall
+			weighingFactor = 0.3635819 - (0.4891775 * (cos(twoPi * ratio))) + (0.1365995 * (cos(fourPi * ratio))) - (0.0106411 * (cos(sixPi * ratio)));
+			break;
+		case FFT_WIN_TYP_BLACKMAN_HARRIS: // blackman harris
+			weighingFactor = 0.35875 - (0.48829 * (cos(twoPi * ratio))) + (0.14128 * (cos(fourPi * ratio))) - (0.01168 * (cos(sixPi * ratio)));
+			break;
+		case FFT_WIN_TYP_FLT_TOP: // flat top
+			weighingFactor = 0.2810639 - (0.5208972 * cos(twoPi * ratio)) + (0.1980399 * cos(fourPi * ratio));
+			break;
+		case FFT_WIN_TYP_WELCH: // welch
+			weighingFactor = 1.0 - sq((indexMinusOne - samplesMinusOne / 2.0) / (samplesMinusOne / 2.0));
+			break;
+		}
+		this->_window[i] = weighingFactor;
+	}
+}
+
+void arduinoFFT::BuildSwaps(uint8_t half)
+{// Records the index pairs of the bit reversal permutation for samples >> half points, once per size,
+	// so Compute and ComputeReal can be mixed on one object without building them again
+	if (this->_swaps[half] != NULL) {
+		return;
+	}
+	uint16_t size = (this->_samples >> half);
+	uint16_t *swaps = new uint16_t[size];	// less than size/2 pairs
+	uint16_t count = 0;
+	uint16_t j = 0;
+	for (uint16_t i = 0; i < (size - 1); i++) {
+		if (i < j) {
+			swaps[2 * count] = i;
+			swaps[2 * count + 1] = j;
+			count++;
+		}
+		uint16_t k = (size >> 1);
+		while (k <= j) {
+			j -= k;
+			k >>= 1;
+		}
+		j += k;
+	}
+	this->_swaps[half] = swaps;
+	this->_swapCount[half] = count;
+}
+
+void arduinoFFT::Twiddle(uint16_t k, float *c, float *s)
+{// Forward twiddle factor exp(-2*pi*i*k/samples) for k < samples/2, from the quarter wave sine table
+	uint16_t quarter = (this->_samples >> 2);
+	if (k <= quarter) {
+		*c = this->_sine[quarter - k];
+		*s = -this->_sine[k];
+	}
+	else {
+		*c = -this->_sine[k - quarter];
+		*s = -this->_sine[(this->_samples >> 1) - k];
+	}
+}
+
 void arduinoFFT::Swap(float *x, float *y)
 {
 	float temp = *x;
@@ -54,6 +54,7 @@
 #define FFT_WIN_TYP_BLACKMAN_HARRIS 0x07 /* blackman harris*/
 #define FFT_WIN_TYP_FLT_TOP 0x08 /* flat top */
 #define FFT_WIN_TYP_WELCH 0x09 /* welch */
+#define FFT_WIN_TYP_NONE 0xFF /* no window table built yet */
 /*Mathematial constants*/
 #define twoPi 6.28318531
 #define fourPi 12.56637061
@@ -77,9 +78,11 @@ public:
 //	void Windowing(float *vData, uint16_t samples, uint8_t windowType, uint8_t dir);
 	void ComplexToMagnitude();
 	void Compute(uint8_t dir);
+	void ComputeReal();
 	void DCRemoval();
 	float MajorPeak();
 	void Windowing(uint8_t windowType, uint8_t dir);
+	const float *WindowTable(uint8_t windowType);
 
 	void MajorPeak(float *f, float *v);
 //	void MajorPeak(float *vD, uint16_t samples, float samplingFrequency, float *f, float *v);
@@ -92,8 +95,18 @@ private:
 	float *_vReal;
 	float *_vImag;
 	uint8_t _power;
+	/* Tables built at run time, the sine table in the constructor, the others on first use, */
+	/* each once, so the per frame transform has no transcendental math and no allocation */
+	float *_sine;			/* quarter wave sine table, samples/4+1 values */
+	uint16_t *_swaps[2];	/* bit reversal index pairs of samples (Compute) and samples/2 (ComputeReal) points */
+	uint16_t _swapCount[2];
+	float *_window;			/* first half of the weighing function */
+	uint8_t _windowType;	/* window type of the weighing table */
 	/* Functions */
 	void Swap(float *x, float *y);
+	void BuildWindow(uint8_t windowType);
+	void BuildSwaps(uint8_t half);
+	inline void Twiddle(uint16_t k, float *c, float *s);
 };
 
 #endif
@@ -0,0 +1,125 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file bands.h
+ * \brief Maps FFT bins to frequency bands.
+ *
+ * The map is built once and tells the energy summation which bins belong to
+ * which band, so bins outside all bands are never touched. Bands are
+ * consecutive ranges of bins, stored as the first and last bin of each band.
+ * A band edge can fall inside a bin, the part of that bin outside the band
+ * is stored as a cut and its share of the energy is left out.
+ */
+
+#ifndef __BANDS_H_
+#define __BANDS_H_
+
+#include <stdint.h>
+#include <math.h>
+#include "config.h"
+
+#define MAX_BANDS 32
+#define THIRD_OCTAVE_BANDS 27       ///< third octaves 25 Hz .. 10 kHz
+
+// whole octaves, numbered from 16 Hz (0) to 16 kHz (10)
+#if defined(IIR_FILTERS)
+#define FIRST_OCTAVE 0              ///< 16 Hz, one more decimation level of the filter bank
+#else
+#define FIRST_OCTAVE 1              ///< 31.5 Hz, the 16 Hz octave of the FFT is less than a bin
+#endif
+#if defined(WIDE_BAND)
+#define LAST_OCTAVE 10              ///< 16 kHz, needs the double sample frequency
+#else
+#define LAST_OCTAVE 9               ///< 8 kHz
+#endif
+#define OCTAVES (LAST_OCTAVE - FIRST_OCTAVE + 1)
+
+#if defined(THIRD_OCTAVES)
+#define BANDS THIRD_OCTAVE_BANDS
+#else
+#define BANDS OCTAVES
+#endif
+
+class BandMap {
+  public:
+    BandMap() { bands = 0; }
+
+    /// \brief append a band
+    /// \param [in] firstBin first FFT bin of the band
+    /// \param [in] lastBin last FFT bin of the band (inclusive)
+    void add(uint16_t firstBin, uint16_t lastBin) {
+      if (bands < MAX_BANDS) {
+        first[bands] = firstBin;
+        last[bands] = lastBin;
+        lowCut[bands] = 0.0;
+        highCut[bands] = 0.0;
+        bands++;
+      }
+    }
+
+    /// \brief append a band with edges at any frequency, the edge bins are weighted by their overlap
+    /// bin k covers the frequencies (k - 0.5) * binWidth .. (k + 0.5) * binWidth
+    /// \param [in] fLow lower edge in Hz
+    /// \param [in] fHigh upper edge in Hz
+    /// \param [in] binWidth bin bandwidth in Hz
+    /// \param [in] maxBin highest bin that may be used
+    void add(float fLow, float fHigh, float binWidth, uint16_t maxBin) {
+      float lo = fLow / binWidth;
+      float hi = fHigh / binWidth;
+      if (lo < 0.5) lo = 0.5;                   // bin 0 (DC) is never used
+      if (hi > maxBin + 0.5) hi = maxBin + 0.5;
+      uint16_t f = (uint16_t)floor(lo + 0.5);
+      uint16_t l = (uint16_t)floor(hi + 0.5);
+      if (l > maxBin) l = maxBin;
+      if (l < f) l = f;
+      add(f, l);
+      if (bands > 0) {
+        lowCut[bands - 1] = lo - (f - 0.5);
+        highCut[bands - 1] = (l + 0.5) - hi;
+      }
+    }
+
+    /// \brief whole octaves, each band is twice as wide as the previous one
+    /// \param [in] firstBin first bin of the lowest octave
+    /// \param [in] count number of octaves
+    void octaves(uint16_t firstBin, int count) {
+      bands = 0;
+      uint16_t size = firstBin;
+      for (int i = 0; i < count; i++) {
+        add(firstBin, firstBin + size - 1);
+        firstBin += size;
+        size *= 2;
+      }
+    }
+
+    /// \brief third octaves 25 Hz .. 10 kHz, mid band frequencies 1000 * 10^(n/10), n = -16 .. 10
+    /// \param [in] binWidth bin bandwidth in Hz
+    /// \param [in] maxBin highest bin that may be used
+    void thirdOctaves(float binWidth, uint16_t maxBin) {
+      bands = 0;
+      for (int n = -16; n < THIRD_OCTAVE_BANDS - 16; n++) {
+        float fc = 1000.0 * pow(10.0, n / 10.0);
+        add((float)(fc * pow(10.0, -0.05)), (float)(fc * pow(10.0, 0.05)), binWidth, maxBin);
+      }
+    }
+
+    uint8_t  bands;                 ///< number of bands
+    uint16_t first[MAX_BANDS];      ///< first bin of each band
+    uint16_t last[MAX_BANDS];       ///< last bin of each band
+    float    lowCut[MAX_BANDS];     ///< part of the first bin below the band
+    float    highCut[MAX_BANDS];    ///< part of the last bin above the band
+};
+
+#endif // __BANDS_H_
@@ -0,0 +1,164 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file capture.h
+ * \brief Framed binary format of the raw I2S blocks streamed over the serial port.
+ *
+ * With RAW_CAPTURE the sensor writes every block the DSP receives as one frame,
+ * between the lines of the log. All values are little endian:
+ *
+ *   bytes 0-3    sync 0xA5 0x5A 0xC3 0x3C
+ *   byte  4      version, 1
+ *   byte  5      flags, CAPTURE_RESTART for the first block after a start of the I2S
+ *   bytes 6-7    number of samples n
+ *   bytes 8-11   block number, counted from the first block after boot
+ *   bytes 12-15  sample frequency in Hz
+ *   bytes 16-19  DMA buffers dropped by the driver so far (overruns)
+ *   20 .. 20+3n  samples, the upper 24 bits of each I2S word, the bits the DSP uses
+ *   4 bytes      CRC-32 of the header and the samples
+ *
+ * A reader finds the frames by the sync and the CRC, all other bytes are log text.
+ * The log line of a report holds the bits of the results, so a replay of the
+ * samples on the host can be compared with the device, see native/replay.cpp.
+ */
+
+#ifndef __CAPTURE_H_
+#define __CAPTURE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "measurement.h"
+
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEADER 20               ///< bytes before the samples
+#define CAPTURE_TRAILER 4               ///< CRC after the samples
+#define CAPTURE_BYTES(n) (CAPTURE_HEADER + 3 * (n) + CAPTURE_TRAILER)   ///< frame of n samples
+#define CAPTURE_MAX_SAMPLES 8192        ///< larger counts are not a frame
+#define CAPTURE_RESTART 0x01            ///< flag, the DSP starts a new window with this block
+#define CAPTURE_REPORT "capture report"  ///< log line of the results of a report
+#define CAPTURE_REPORT_SIZE (64 + 9 * (9 + MAX_BANDS))   ///< buffer of the line
+
+static const uint8_t CAPTURE_SYNC[4] = { 0xA5, 0x5A, 0xC3, 0x3C };
+
+/// \brief CRC-32 (IEEE, as zip), continues from crc, start with 0
+/// four bits at a time, a table of 16 entries
+static inline uint32_t captureCrc(uint32_t crc, const uint8_t *data, size_t n) {
+  static const uint32_t table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C };
+  crc = ~crc;
+  for (size_t i = 0; i < n; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+static inline void capturePut16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static inline void capturePut32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+static inline uint16_t captureGet16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t captureGet32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/// \brief frame of n I2S words, frame holds CAPTURE_BYTES(n) bytes
+static inline void captureEncode(uint8_t *frame, uint32_t block, uint32_t rate, uint32_t overruns, uint8_t flags,
+                                 const int32_t *samples, uint16_t n) {
+  memcpy(frame, CAPTURE_SYNC, sizeof(CAPTURE_SYNC));
+  frame[4] = CAPTURE_VERSION;
+  frame[5] = flags;
+  capturePut16(frame + 6, n);
+  capturePut32(frame + 8, block);
+  capturePut32(frame + 12, rate);
+  capturePut32(frame + 16, overruns);
+  uint8_t *p = frame + CAPTURE_HEADER;
+  for (uint16_t i = 0; i < n; i++) {
+    uint32_t v = (uint32_t)samples[i] >> 8;
+    *p++ = v & 0xFF;
+    *p++ = (v >> 8) & 0xFF;
+    *p++ = (v >> 16) & 0xFF;
+  }
+  capturePut32(p, captureCrc(0, frame, p - frame));
+}
+
+/// \brief length of the frame at data, 0 if there is no valid frame
+/// \param [in] size bytes available from data
+static inline size_t captureCheck(const uint8_t *data, size_t size) {
+  if (size < CAPTURE_BYTES(0) || memcmp(data, CAPTURE_SYNC, sizeof(CAPTURE_SYNC)) != 0 || data[4] != CAPTURE_VERSION)
+    return 0;
+  uint16_t n = captureGet16(data + 6);
+  if (n > CAPTURE_MAX_SAMPLES || size < (size_t)CAPTURE_BYTES(n))
+    return 0;
+  size_t length = CAPTURE_HEADER + 3 * n;
+  if (captureCrc(0, data, length) != captureGet32(data + length))
+    return 0;
+  return CAPTURE_BYTES(n);
+}
+
+/// \brief the samples of a valid frame as I2S words, the lower 8 bits are 0
+static inline void captureDecode(const uint8_t *frame, int32_t *samples) {
+  uint16_t n = captureGet16(frame + 6);
+  const uint8_t *p = frame + CAPTURE_HEADER;
+  for (uint16_t i = 0; i < n; i++, p += 3)
+    samples[i] = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24);
+}
+
+// float bits in hex, exact and independent of the rounding of printf
+static inline int captureBits(char *line, size_t size, float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return snprintf(line, size, "%08x", (unsigned)bits);
+}
+
+/// \brief log line of a report, after frames frames: min, max and avg of A, C and Z and the Z spectrum as float bits
+/// \param [out] line CAPTURE_REPORT_SIZE chars
+/// \return length of the line, without a newline
+static inline int captureReport(char *line, uint32_t frames, const Measurement::Result &la,
+                                const Measurement::Result &lc, const Measurement::Result &lz, int bands) {
+  const size_t size = CAPTURE_REPORT_SIZE;
+  const Measurement::Result *results[3] = { &la, &lc, &lz };
+  const char names[3] = { 'a', 'c', 'z' };
+  int n = snprintf(line, size, CAPTURE_REPORT " frames=%u", (unsigned)frames);
+  for (int m = 0; m < 3; m++) {
+    n += snprintf(line + n, size - n, " %c=", names[m]);
+    n += captureBits(line + n, size - n, results[m]->min);
+    n += snprintf(line + n, size - n, ",");
+    n += captureBits(line + n, size - n, results[m]->max);
+    n += snprintf(line + n, size - n, ",");
+    n += captureBits(line + n, size - n, results[m]->avg);
+  }
+  n += snprintf(line + n, size - n, " spectrum=");
+  for (int i = 0; i < bands; i++) {
+    if (i > 0)
+      n += snprintf(line + n, size - n, ",");
+    n += captureBits(line + n, size - n, lz.spectrum[i]);
+  }
+  return n;
+}
+
+#endif // __CAPTURE_H_
@@ -18,6 +18,39 @@
 // otherwise define 0.0
 #define MIC_OFFSET 1.5
 
+// DSP options
+// define FIXED_POINT_DSP to use integer (Q31) math from I2S samples to octave energies,
+// for processors without a fast FPU
+//#define FIXED_POINT_DSP
+
+// define THIRD_OCTAVES to measure 27 third octave bands (25 Hz .. 10 kHz) instead of 9 octaves,
+// the payload is sent on port 23 instead of 22
+//#define THIRD_OCTAVES
+
+// define OVERLAP_FRAMES to analyse windows that overlap by 50%, every half block a new frame (22 frames/s),
+// short sound events near a block edge are no longer suppressed by the HANN window
+//#define OVERLAP_FRAMES
+
+// define IIR_FILTERS to measure with time domain filters instead of the FFT: A and C weighting filters
+// and an octave filter bank, gapless and with the exact weighting curves, whole octaves in float only,
+// from 16 Hz on; the payload is sent on port 24, or 26 with WIDE_BAND
+//#define IIR_FILTERS
+
+// define WIDE_BAND to sample at 45254 Hz instead of 22627 Hz and add the 16 kHz octave, the FFT has 4096
+// points so the bins stay 11 Hz wide, twice the DSP load; the payload is sent on port 25
+//#define WIDE_BAND
+
+// define DSP_PROFILE to time each DSP stage with the cycle counter, min/mean/max and a histogram per stage
+// and the duty cycle and headroom of the audio core are printed with each report; nothing is compiled in without it
+//#define DSP_PROFILE
+
+// define DSP_PROFILE_UPLINK to also send the profile every 10th report on the diagnostics port 30, needs DSP_PROFILE
+//#define DSP_PROFILE_UPLINK
+
+// define RAW_CAPTURE to stream every I2S block the DSP receives over the serial port, in frames between the
+// log lines (see capture.h), at 921600 baud or 2000000 wide band; native/replay.cpp replays a capture on a host
+//#define RAW_CAPTURE
+
 // specify here TTN keys
 
 #define APPEUI "70B3D57ED003ED46"
@@ -0,0 +1,51 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file events.h
+ * \brief Events that wake up the LoRa core, a FreeRTOS event group.
+ *
+ * The audio core sets FRAME_READY after each frame it pushes, the LMIC event callback
+ * sets TX_COMPLETE when the send or join request of the worker is ready. The loop of
+ * core 1 sleeps in waitEvents() until one of them is set, then takes them and does the
+ * work of each in its own context, so nothing runs inside the LMIC callback.
+ * waitEvents() leaves the bits set and takeEvents() clears them, an event set between
+ * the two is seen by the next take, none is lost.
+ *
+ * The host build has a stand-in of the event group with a condition variable,
+ * native/include/freertos/event_groups.h, tested by native/events_test.cpp.
+ */
+
+#ifndef __EVENTS_H_
+#define __EVENTS_H_
+
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+#define FRAME_READY (1 << 0)        ///< core 0 has pushed an audio frame
+#define TX_COMPLETE (1 << 1)        ///< the send or join request of the worker is ready
+#define CORE_EVENTS (FRAME_READY | TX_COMPLETE)
+
+/// \brief sleep until one of the events is set, at most ms, the events stay set
+static inline void waitEvents( EventGroupHandle_t events, uint32_t ms) {
+  xEventGroupWaitBits( events, CORE_EVENTS, pdFALSE, pdFALSE, pdMS_TO_TICKS( ms));
+}
+
+/// \brief the events that are set, they are cleared
+static inline EventBits_t takeEvents( EventGroupHandle_t events) {
+  return xEventGroupClearBits( events, CORE_EVENTS) & CORE_EVENTS;
+}
+
+#endif // __EVENTS_H_
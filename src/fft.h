@@ -0,0 +1,220 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file fft.h
+ * \brief FFT engine specialized at compile time on size and radix.
+ *
+ * The size N is a template parameter, so all loop bounds are constants and
+ * the compiler can unroll the first stages. Radix 4 butterflies are used
+ * where possible, with one radix 2 stage when log2(N) is odd.
+ * Twiddle factors come from a quarter wave sine table and the bit reversal
+ * permutation from a swap list, both computed once in the constructor.
+ *
+ * Data is interleaved complex: v[2k] = Re, v[2k+1] = Im.
+ */
+
+#ifndef __FFT_H_
+#define __FFT_H_
+
+#include <stdint.h>
+#include <math.h>
+
+/// \brief compile time log2 of a power of two
+template <uint16_t N> struct Log2 { static const uint8_t value = 1 + Log2<N / 2>::value; };
+template <> struct Log2<1> { static const uint8_t value = 0; };
+
+/// \brief in-place forward complex FFT of N points
+template <uint16_t N, uint8_t RADIX = 4>
+class Fft {
+  public:
+    static const uint16_t SIZE = N;
+    static const uint8_t POWER = Log2<N>::value;
+    static const bool RADIX2_STAGE = (RADIX == 2) || (POWER & 1);   ///< first stage is a radix 2 stage
+
+    Fft() {
+      for (uint16_t k = 0; k <= N / 4; k++)
+        _sine[k] = sin((2.0 * M_PI * k) / N);
+      _swapCount = 0;
+      uint16_t j = 0;
+      for (uint16_t i = 0; i < N - 1; i++) {
+        if (i < j) {
+          _swaps[2 * _swapCount] = i;
+          _swaps[2 * _swapCount + 1] = j;
+          _swapCount++;
+        }
+        uint16_t k = N >> 1;
+        while (k <= j) {
+          j -= k;
+          k >>= 1;
+        }
+        j += k;
+      }
+    }
+
+    /// \brief forward transform of N interleaved complex values
+    void forward(float *v) {
+      for (uint16_t s = 0; s < _swapCount; s++) {
+        uint16_t i = 2 * _swaps[2 * s];
+        uint16_t j = 2 * _swaps[2 * s + 1];
+        float t = v[i];     v[i] = v[j];         v[j] = t;
+        t = v[i + 1];       v[i + 1] = v[j + 1]; v[j + 1] = t;
+      }
+      uint16_t l = 1;
+      if (RADIX2_STAGE) {
+        if (RADIX == 2) {
+          for (; l < N; l <<= 1)
+            radix2(v, l);
+          return;
+        }
+        radix2(v, 1);
+        l = 2;
+      }
+      for (; l < N; l <<= 2)
+        radix4(v, l);
+    }
+
+    /// \brief twiddle factor exp(-2*pi*i*k/N) for 0 <= k < N
+    inline void twiddle(uint16_t k, float &c, float &s) const {
+      const uint16_t q = N / 4;
+      if (k <= q)          { c =  _sine[q - k];         s = -_sine[k]; }
+      else if (k <= 2 * q) { c = -_sine[k - q];         s = -_sine[2 * q - k]; }
+      else if (k <= 3 * q) { c = -_sine[3 * q - k];     s =  _sine[k - 2 * q]; }
+      else                 { c =  _sine[k - 3 * q];     s =  _sine[N - k]; }
+    }
+
+  private:
+    float    _sine[N / 4 + 1];     ///< quarter wave sine table
+    uint16_t _swaps[N];            ///< bit reversal index pairs
+    uint16_t _swapCount;
+
+    // combines pairs of DFTs of size l into DFTs of size 2l
+    void radix2(float *v, uint16_t l) {
+      const uint16_t step = N / (2 * l);
+      // j = 0, the twiddle is 1
+      for (uint16_t i = 0; i < N; i += 2 * l) {
+        float *a = v + 2 * i;
+        float *b = v + 2 * (i + l);
+        float tr = b[0], ti = b[1];
+        b[0] = a[0] - tr;
+        b[1] = a[1] - ti;
+        a[0] += tr;
+        a[1] += ti;
+      }
+      for (uint16_t j = 1; j < l; j++) {
+        float wr, wi;
+        twiddle(j * step, wr, wi);
+        for (uint16_t i = j; i < N; i += 2 * l) {
+          float *a = v + 2 * i;
+          float *b = v + 2 * (i + l);
+          float tr = wr * b[0] - wi * b[1];
+          float ti = wr * b[1] + wi * b[0];
+          b[0] = a[0] - tr;
+          b[1] = a[1] - ti;
+          a[0] += tr;
+          a[1] += ti;
+        }
+      }
+    }
+
+    // combines four DFTs of size l into DFTs of size 4l
+    // after bit reversal the blocks at i, i+l, i+2l, i+3l hold the samples 0, 2, 1, 3 modulo 4
+    void radix4(float *v, uint16_t l) {
+      const uint16_t step = N / (4 * l);
+      // j = 0, the twiddles are 1, this is the whole first stage
+      for (uint16_t i = 0; i < N; i += 4 * l) {
+        float *p0 = v + 2 * i;
+        float *p1 = v + 2 * (i + l);
+        float *p2 = v + 2 * (i + 2 * l);
+        float *p3 = v + 2 * (i + 3 * l);
+        butterfly(p0, p1, p2, p3, p2[0], p2[1], p1[0], p1[1], p3[0], p3[1]);
+      }
+      for (uint16_t j = 1; j < l; j++) {
+        float w1r, w1i, w2r, w2i, w3r, w3i;
+        twiddle(j * step, w1r, w1i);
+        twiddle(2 * j * step, w2r, w2i);
+        twiddle(3 * j * step, w3r, w3i);
+        for (uint16_t i = j; i < N; i += 4 * l) {
+          float *p0 = v + 2 * i;
+          float *p1 = v + 2 * (i + l);
+          float *p2 = v + 2 * (i + 2 * l);
+          float *p3 = v + 2 * (i + 3 * l);
+          butterfly(p0, p1, p2, p3,
+            w1r * p2[0] - w1i * p2[1], w1r * p2[1] + w1i * p2[0],
+            w2r * p1[0] - w2i * p1[1], w2r * p1[1] + w2i * p1[0],
+            w3r * p3[0] - w3i * p3[1], w3r * p3[1] + w3i * p3[0]);
+        }
+      }
+    }
+
+    // radix 4 butterfly, t1, t2 and t3 are the twiddled values of p2, p1 and p3
+    static inline void butterfly(float *p0, float *p1, float *p2, float *p3,
+        float t1r, float t1i, float t2r, float t2i, float t3r, float t3i) {
+      float t0r = p0[0], t0i = p0[1];
+      float s0r = t0r + t2r, s0i = t0i + t2i;
+      float s1r = t0r - t2r, s1i = t0i - t2i;
+      float s2r = t1r + t3r, s2i = t1i + t3i;
+      float s3r = t1r - t3r, s3i = t1i - t3i;
+      p0[0] = s0r + s2r;  p0[1] = s0i + s2i;
+      p2[0] = s0r - s2r;  p2[1] = s0i - s2i;
+      p1[0] = s1r + s3i;  p1[1] = s1i - s3r;    // s1 - i*s3
+      p3[0] = s1r - s3i;  p3[1] = s1i + s3r;    // s1 + i*s3
+    }
+};
+
+/// \brief in-place forward FFT of N real values, using a complex FFT of N/2 points
+///
+/// Result: v[2k] = Re(X[k]), v[2k+1] = Im(X[k]) for k = 1 .. N/2-1,
+/// v[0] = X[0] and v[1] = X[N/2] (both purely real), the same layout as arduinoFFT::ComputeReal.
+template <uint16_t N, uint8_t RADIX = 4>
+class RealFft {
+  public:
+    static const uint16_t SIZE = N;
+
+    RealFft() {
+      for (uint16_t k = 0; k <= N / 4; k++)
+        _sine[k] = sin((2.0 * M_PI * k) / N);
+    }
+
+    void forward(float *v) {
+      _fft.forward(v);
+      // split: X[k] = Fe + W^k * Fo, X[n-k] = conj(Fe - W^k * Fo), W = exp(-2*pi*i/N)
+      const uint16_t n = N / 2;
+      float r0 = v[0];
+      v[0] = r0 + v[1];     // DC
+      v[1] = r0 - v[1];     // Nyquist
+      for (uint16_t k = 1; k < n / 2; k++) {
+        uint16_t m = n - k;
+        float er = 0.5f * (v[2 * k] + v[2 * m]);
+        float ei = 0.5f * (v[2 * k + 1] - v[2 * m + 1]);
+        float odr = 0.5f * (v[2 * k + 1] + v[2 * m + 1]);
+        float odi = -0.5f * (v[2 * k] - v[2 * m]);
+        float wr = _sine[N / 4 - k];
+        float wi = -_sine[k];
+        float tr = wr * odr - wi * odi;
+        float ti = wr * odi + wi * odr;
+        v[2 * k] = er + tr;
+        v[2 * k + 1] = ei + ti;
+        v[2 * m] = er - tr;
+        v[2 * m + 1] = ti - ei;
+      }
+      v[n + 1] = -v[n + 1];  // k = N/4, W^k = -i
+    }
+
+  private:
+    Fft<N / 2, RADIX> _fft;
+    float _sine[N / 4 + 1];       ///< quarter wave sine table for the split
+};
+
+#endif // __FFT_H_
@@ -0,0 +1,165 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file fixedfft.h
+ * \brief Fixed point FFT of N real values, integer math only.
+ *
+ * Data is Q31 with block floating point scaling: a stage is scaled down by
+ * 2 only when the previous stage output comes close to overflow, and the
+ * number of scale steps is returned as exponent. Twiddles are Q31 from a
+ * quarter wave sine table, products are done in 64 bits.
+ *
+ * The output layout is the same as RealFft in fft.h:
+ * v[2k] = Re(X[k]), v[2k+1] = Im(X[k]) for k = 1 .. N/2-1,
+ * v[0] = X[0] and v[1] = X[N/2], the true spectrum is X * 2^exponent.
+ */
+
+#ifndef __FIXED_FFT_H_
+#define __FIXED_FFT_H_
+
+#include <stdint.h>
+#include <math.h>
+
+#define FIXED_HEADROOM (1L << 29)     ///< scale a stage when a value reaches this level
+
+template <uint16_t N>
+class FixedRealFft {
+  public:
+    FixedRealFft() {
+      for (uint16_t k = 0; k <= N / 4; k++) {
+        double s = sin((2.0 * M_PI * k) / N) * 2147483648.0;
+        _sine[k] = (s >= 2147483647.0) ? 0x7FFFFFFF : (int32_t)lround(s);
+      }
+      _swapCount = 0;
+      uint16_t j = 0;
+      for (uint16_t i = 0; i < N / 2 - 1; i++) {
+        if (i < j) {
+          _swaps[2 * _swapCount] = i;
+          _swaps[2 * _swapCount + 1] = j;
+          _swapCount++;
+        }
+        uint16_t k = N / 4;
+        while (k <= j) {
+          j -= k;
+          k >>= 1;
+        }
+        j += k;
+      }
+      _peak = 0;
+    }
+
+    /// \brief forward transform of N real Q31 values, in place
+    /// \return exponent, the number of times the data has been scaled down by 2
+    int8_t forward(int32_t *v) {
+      const uint16_t n = N / 2;
+      int8_t exponent = 0;
+      uint32_t peak = 0;
+      for (uint16_t i = 0; i < N; i++)
+        peak |= magnitude(v[i]);
+
+      for (uint16_t s = 0; s < _swapCount; s++) {
+        uint16_t i = 2 * _swaps[2 * s];
+        uint16_t j = 2 * _swaps[2 * s + 1];
+        int32_t t = v[i];   v[i] = v[j];         v[j] = t;
+        t = v[i + 1];       v[i + 1] = v[j + 1]; v[j + 1] = t;
+      }
+
+      // radix 2 stages of the complex FFT of n points
+      for (uint16_t l = 1; l < n; l <<= 1) {
+        uint8_t shift = (peak >= FIXED_HEADROOM) ? 1 : 0;
+        exponent += shift;
+        peak = 0;
+        const uint16_t step = N / (2 * l);
+        // j = 0, the twiddle is 1, no products
+        for (uint16_t i = 0; i < n; i += 2 * l) {
+          int32_t *a = v + 2 * i;
+          int32_t *b = v + 2 * (i + l);
+          int32_t ar = a[0] >> shift, ai = a[1] >> shift;
+          int32_t br = b[0] >> shift, bi = b[1] >> shift;
+          a[0] = ar + br;  a[1] = ai + bi;
+          b[0] = ar - br;  b[1] = ai - bi;
+          peak |= magnitude(a[0]) | magnitude(a[1]) | magnitude(b[0]) | magnitude(b[1]);
+        }
+        for (uint16_t j = 1; j < l; j++) {
+          int32_t wr, wi;
+          twiddle(j * step, wr, wi);
+          for (uint16_t i = j; i < n; i += 2 * l) {
+            int32_t *a = v + 2 * i;
+            int32_t *b = v + 2 * (i + l);
+            int32_t ar = a[0] >> shift, ai = a[1] >> shift;
+            int32_t br = b[0] >> shift, bi = b[1] >> shift;
+            int32_t tr = (int32_t)(((int64_t)br * wr - (int64_t)bi * wi) >> 31);
+            int32_t ti = (int32_t)(((int64_t)bi * wr + (int64_t)br * wi) >> 31);
+            a[0] = ar + tr;  a[1] = ai + ti;
+            b[0] = ar - tr;  b[1] = ai - ti;
+            peak |= magnitude(a[0]) | magnitude(a[1]) | magnitude(b[0]) | magnitude(b[1]);
+          }
+        }
+      }
+
+      if (peak >= FIXED_HEADROOM) {
+        for (uint16_t i = 0; i < N; i++)
+          v[i] >>= 1;
+        exponent++;
+      }
+
+      // split: X[k] = Fe + W^k * Fo, X[n-k] = conj(Fe - W^k * Fo), the factor 1/2 is a shift
+      peak = 0;
+      int32_t r0 = v[0];
+      v[0] = r0 + v[1];     // DC
+      v[1] = r0 - v[1];     // Nyquist
+      peak |= magnitude(v[0]) | magnitude(v[1]);
+      for (uint16_t k = 1; k < n / 2; k++) {
+        uint16_t m = n - k;
+        int32_t er = (v[2 * k] + v[2 * m]) >> 1;
+        int32_t ei = (v[2 * k + 1] - v[2 * m + 1]) >> 1;
+        int32_t odr = (v[2 * k + 1] + v[2 * m + 1]) >> 1;
+        int32_t odi = (v[2 * m] - v[2 * k]) >> 1;
+        int32_t wr = _sine[N / 4 - k];
+        int32_t wi = -_sine[k];
+        int32_t tr = (int32_t)(((int64_t)odr * wr - (int64_t)odi * wi) >> 31);
+        int32_t ti = (int32_t)(((int64_t)odi * wr + (int64_t)odr * wi) >> 31);
+        v[2 * k] = er + tr;
+        v[2 * k + 1] = ei + ti;
+        v[2 * m] = er - tr;
+        v[2 * m + 1] = ti - ei;
+        peak |= magnitude(v[2 * k]) | magnitude(v[2 * k + 1]) | magnitude(v[2 * m]) | magnitude(v[2 * m + 1]);
+      }
+      v[n + 1] = -v[n + 1];  // k = N/4, W^k = -i
+      peak |= magnitude(v[n]) | magnitude(v[n + 1]);
+      _peak = peak;
+      return exponent;
+    }
+
+    /// \brief bitwise or of all output magnitudes of the last transform, bounds the output level
+    uint32_t peak() { return _peak; }
+
+  private:
+    int32_t  _sine[N / 4 + 1];     ///< quarter wave sine table in Q31
+    uint16_t _swaps[N / 2];        ///< bit reversal index pairs of the n point complex FFT
+    uint16_t _swapCount;
+    uint32_t _peak;
+
+    static inline uint32_t magnitude(int32_t x) { return (uint32_t)(x ^ (x >> 31)); }
+
+    // twiddle factor exp(-2*pi*i*k/N) in Q31 for 0 <= k < N/2
+    inline void twiddle(uint16_t k, int32_t &c, int32_t &s) const {
+      const uint16_t q = N / 4;
+      if (k <= q) { c =  _sine[q - k]; s = -_sine[k]; }
+      else        { c = -_sine[k - q]; s = -_sine[2 * q - k]; }
+    }
+};
+
+#endif // __FIXED_FFT_H_
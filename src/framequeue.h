@@ -0,0 +1,89 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file framequeue.h
+ * \brief Lock-free queue of audio frames from the audio core to the LoRa core.
+ *
+ * One task pushes (the producer) and one other task pops (the consumer),
+ * no locks are needed. Head and tail are free running counters, head is
+ * only written by the producer and tail only by the consumer. The release
+ * store of an index publishes the item written before it, the acquire load
+ * on the other side makes that item visible before it is used.
+ *
+ * When the queue is full the producer drops the frame, the consumer sees
+ * this as a gap in the sequence numbers.
+ */
+
+#ifndef __FRAME_QUEUE_H_
+#define __FRAME_QUEUE_H_
+
+#include <stdint.h>
+#include <atomic>
+#include "bands.h"
+#ifdef IIR_FILTERS
+#include "iirfilters.h"
+#endif
+
+/// \brief band energies of one audio frame
+struct AudioFrame {
+  uint32_t seq;                 ///< sequence number, counts all frames including dropped ones
+  uint32_t time;                ///< millis() at the end of the frame
+  float    energy[BANDS];       ///< energy per band
+#ifdef IIR_FILTERS
+  float    weighted[WEIGHTED_CURVES];  ///< A and C weighted energy of the weighting filters
+#endif
+};
+
+/// \brief single producer, single consumer ring of N items, N must be a power of 2
+template <typename T, uint16_t N>
+class FrameQueue {
+  public:
+    FrameQueue() : _head(0), _tail(0) {}
+
+    /// \brief append a copy of item, producer side only
+    /// \return false when the queue is full, the item is not added
+    bool push(const T &item) {
+      uint32_t head = _head.load(std::memory_order_relaxed);
+      if (head - _tail.load(std::memory_order_acquire) >= N)
+        return false;
+      _items[head & (N - 1)] = item;
+      _head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    /// \brief remove the oldest item, consumer side only
+    /// \return false when the queue is empty
+    bool pop(T &item) {
+      uint32_t tail = _tail.load(std::memory_order_relaxed);
+      if (_head.load(std::memory_order_acquire) == tail)
+        return false;
+      item = _items[tail & (N - 1)];
+      _tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    /// \brief number of items in the queue, exact on the consumer side
+    uint16_t size() const {
+      return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+  private:
+    static_assert((N & (N - 1)) == 0, "queue size must be a power of 2");
+    std::atomic<uint32_t> _head;    ///< items pushed
+    std::atomic<uint32_t> _tail;    ///< items popped
+    T _items[N];
+};
+
+#endif // __FRAME_QUEUE_H_
@@ -0,0 +1,86 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file histogram.h
+ * \brief Histogram of sound levels, for statistical levels like L10 and L90.
+ *
+ * Each measurement is counted in a bin of 0.1 dB over 0 .. 140 dB, so the
+ * memory is fixed whatever the number of measurements, and an update is
+ * one log10 and one increment. LN is the level exceeded during N% of the
+ * measurements, it is found by summing up the bins from the top.
+ */
+
+#ifndef __HISTOGRAM_H_
+#define __HISTOGRAM_H_
+
+#include <stdint.h>
+#include <math.h>
+
+#define HISTOGRAM_RANGE 140.0                              ///< dB, levels above are counted in the top bin
+#define HISTOGRAM_RESOLUTION 0.1                           ///< dB per bin
+#define HISTOGRAM_BINS 1400                                ///< HISTOGRAM_RANGE / HISTOGRAM_RESOLUTION
+
+class LevelHistogram {
+  public:
+    LevelHistogram() { reset(); }
+
+    void reset() {
+      for (int i = 0; i < HISTOGRAM_BINS; i++)
+        _count[i] = 0;
+      _n = 0;
+    }
+
+    /// \brief count the level of one measurement
+    /// \param [in] energy energy of the measurement, the level is 10 * log10(energy) dB
+    void add(float energy) {
+      int bin = 0;
+      if (energy > 1.0) {
+        bin = (int)(10.0f * log10f(energy) * (float)(1.0 / HISTOGRAM_RESOLUTION));
+        if (bin >= HISTOGRAM_BINS)
+          bin = HISTOGRAM_BINS - 1;
+      }
+      if (_count[bin] < UINT16_MAX) {     // 65535 measurements in one bin is 99 min. at 11 frames/s, 49 min. at 22 frames/s with OVERLAP_FRAMES
+        _count[bin]++;
+        _n++;
+      }
+    }
+
+    /// \brief level exceeded during a part of the measurements
+    /// \param [in] percent part of the measurements, 10.0 gives L10
+    /// \return level in dB, the middle of the bin, 0.0 when there are no measurements
+    float exceeded(float percent) const {
+      if (_n == 0)
+        return 0.0;
+      uint32_t limit = (uint32_t)ceilf(_n * percent / 100.0f);
+      if (limit == 0)
+        limit = 1;
+      uint32_t sum = 0;
+      int bin = HISTOGRAM_BINS - 1;
+      for (; bin > 0; bin--) {
+        sum += _count[bin];
+        if (sum >= limit)
+          break;
+      }
+      return (bin + 0.5) * HISTOGRAM_RESOLUTION;
+    }
+
+    uint32_t count() const { return _n; }
+
+  private:
+    uint16_t _count[HISTOGRAM_BINS];   ///< measurements per bin
+    uint32_t _n;                       ///< measurements in all bins
+};
+
+#endif // __HISTOGRAM_H_
@@ -0,0 +1,271 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file iirfilters.h
+ * \brief Time domain A and C weighting filters and a multirate octave filter bank.
+ *
+ * All filters are cascades of second order sections, designed once from the
+ * analog poles and zeros with the bilinear transform. The A and C weighting
+ * filters follow the analog curves of IEC 61672, so the weighting is exact
+ * within a band instead of one factor per band.
+ *
+ * The octave filter bank follows ANSI S1.11: each octave is a 3rd order
+ * Butterworth band pass. The top octave fs/4 .. fs/2 is a high pass, the
+ * octave below it fs/8 .. fs/4 a band pass. Then the signal is low pass
+ * filtered and decimated by 2, and the same band pass gives the next octave
+ * down. So every octave is filtered at 4 .. 8 times its own bandwidth, and all
+ * levels together cost less than twice the top level.
+ *
+ * In digital silence the states of a filter would decay into the denormals, and
+ * each operation on a denormal takes many times as long: the frames after a sound
+ * got 30 times slower. So each section adds DENORMAL_OFFSET to its output, its
+ * states settle at a tiny normal value instead. A sound is millions of times larger,
+ * there the offset is lost in the rounding.
+ */
+
+#ifndef __IIR_FILTERS_H_
+#define __IIR_FILTERS_H_
+
+#include <stdint.h>
+#include <math.h>
+#include <complex>
+
+typedef std::complex<double> Complex;
+
+#define DENORMAL_OFFSET 1e-15f      ///< DC added by every section, 200 dB below one bit of the microphone, squared still normal
+
+/// \brief bilinear transform of an analog pole or zero to the z plane
+static inline Complex bilinear(Complex s, double fs) {
+  return (2.0 * fs + s) / (2.0 * fs - s);
+}
+
+/// \brief analog frequency in rad/s that the bilinear transform maps to f
+static inline double prewarp(double f, double fs) {
+  return 2.0 * fs * tan(M_PI * f / fs);
+}
+
+/// \brief second order section, transposed direct form II
+/// a first order section has b2 = a2 = 0
+struct Biquad {
+  float b0, b1, b2, a1, a2;
+  float z1, z2;               ///< state
+
+  /// \brief section from two zeros and two poles in the z plane, both real or a conjugate pair
+  void set(Complex zero1, Complex zero2, Complex pole1, Complex pole2) {
+    b0 = 1.0;
+    b1 = -(zero1 + zero2).real();
+    b2 = (zero1 * zero2).real();
+    a1 = -(pole1 + pole2).real();
+    a2 = (pole1 * pole2).real();
+    z1 = z2 = 0.0;
+  }
+
+  /// \brief complex response at exp(i * w)
+  Complex response(double w) const {
+    Complex d1 = std::polar(1.0, -w);   // z^-1
+    Complex d2 = d1 * d1;
+    return ((double)b0 + (double)b1 * d1 + (double)b2 * d2) / (1.0 + (double)a1 * d1 + (double)a2 * d2);
+  }
+
+  // the offset is part of y, so it feeds back through -a1 * y and -a2 * y: it enters after the
+  // zeros and gets the DC gain of the poles, in silence y settles at DENORMAL_OFFSET / (1 + a1 + a2).
+  // That gain is below 2 in the octave filters and 3e4 in the first section of the A and C weighting,
+  // there y settles at 3e-11, still 110 dB below one bit of the microphone.
+  inline float process(float x) {
+    float y = (b0 * x + DENORMAL_OFFSET) + z1;
+    z1 = b1 * x - a1 * y + z2;
+    z2 = b2 * x - a2 * y;
+    return y;
+  }
+};
+
+/// \brief cascade of S second order sections
+template <uint8_t S>
+class IirFilter {
+  public:
+    Biquad section[S];
+
+    /// \brief scale the cascade to a gain at frequency f
+    void normalize(double f, double fs, double gain = 1.0) {
+      Complex h = 1.0;
+      for (uint8_t i = 0; i < S; i++)
+        h *= section[i].response(2.0 * M_PI * f / fs);
+      float g = gain / std::abs(h);
+      section[0].b0 *= g;
+      section[0].b1 *= g;
+      section[0].b2 *= g;
+    }
+
+    void reset() {
+      for (uint8_t i = 0; i < S; i++)
+        section[i].z1 = section[i].z2 = 0.0;
+    }
+
+    inline float process(float x) {
+      for (uint8_t i = 0; i < S; i++)
+        x = section[i].process(x);
+      return x;
+    }
+
+    /// \brief filter n samples and return the sum of the squared output
+    float energy(const float *v, uint16_t n) {
+      float sum = 0.0;
+      for (uint16_t i = 0; i < n; i++) {
+        float y = process(v[i]);
+        sum += y * y;
+      }
+      return sum;
+    }
+};
+
+#define WEIGHTED_CURVES 2          ///< A and C weighting filters
+
+// analog poles of the weighting curves in Hz, IEC 61672
+#define WEIGHTING_F1 20.598997
+#define WEIGHTING_F2 107.65265
+#define WEIGHTING_F3 737.86223
+#define WEIGHTING_F4 12194.217
+
+/// \brief section for the double pole at f4 of the A and C weighting
+/// f4 is above fs/2, the bilinear transform would squeeze it into the audio band and put
+/// a double zero at fs/2 (-16 dB at 10 kHz for fs = 22627 Hz). So the poles are matched,
+/// z = exp(-w4 / fs), and the double zero is set to give the analog response at fs/2.
+static inline void designWeightingRollOff(Biquad &section, double fs) {
+  double p = exp(-2.0 * M_PI * WEIGHTING_F4 / fs);
+  double r = fs / 2.0 / WEIGHTING_F4;
+  double t = 1.0 / sqrt(1.0 + r * r);                          // analog response of one pole at fs/2
+  double q = t * (1.0 + p) / (1.0 - p);                        // (1 + z0) / (1 - z0), the same response
+  double z0 = (q - 1.0) / (q + 1.0);
+  section.set(z0, z0, p, p);
+}
+
+/// \brief A weighting, H(s) = k s^4 / ((s + w1)^2 (s + w2) (s + w3) (s + w4)^2), 0 dB at 1 kHz
+static inline void designAWeighting(IirFilter<3> &filter, double fs) {
+  Complex one = 1.0;
+  Complex p1 = bilinear(-2.0 * M_PI * WEIGHTING_F1, fs);
+  Complex p2 = bilinear(-2.0 * M_PI * WEIGHTING_F2, fs);
+  Complex p3 = bilinear(-2.0 * M_PI * WEIGHTING_F3, fs);
+  filter.section[0].set(one, one, p1, p1);              // zeros at s = 0 map to z = 1
+  filter.section[1].set(one, one, p2, p3);
+  designWeightingRollOff(filter.section[2], fs);
+  filter.normalize(1000.0, fs);
+}
+
+/// \brief C weighting, H(s) = k s^2 / ((s + w1)^2 (s + w4)^2), 0 dB at 1 kHz
+static inline void designCWeighting(IirFilter<2> &filter, double fs) {
+  Complex one = 1.0;
+  Complex p1 = bilinear(-2.0 * M_PI * WEIGHTING_F1, fs);
+  filter.section[0].set(one, one, p1, p1);
+  designWeightingRollOff(filter.section[1], fs);
+  filter.normalize(1000.0, fs);
+}
+
+// poles of the 3rd order Butterworth low pass prototype, the upper half plane and the real one
+static const Complex BUTTERWORTH3[2] = { Complex(-0.5, 0.8660254037844386), Complex(-1.0, 0.0) };
+
+/// \brief 3rd order Butterworth band pass fLow .. fHigh, 0 dB in the middle
+static inline void designBandPass(IirFilter<3> &filter, double fLow, double fHigh, double fs) {
+  double wl = prewarp(fLow, fs);
+  double wh = prewarp(fHigh, fs);
+  double w0 = sqrt(wl * wh);
+  double bw = wh - wl;
+  // s -> (s^2 + w0^2) / (bw s), each prototype pole p gives the poles of s^2 - p bw s + w0^2
+  // the complex prototype pole gives two poles of different sections, the conjugate pole gives
+  // their conjugates, the real prototype pole gives a conjugate pair
+  Complex p = BUTTERWORTH3[0] * bw;
+  Complex d = sqrt(p * p - 4.0 * w0 * w0);
+  Complex r = BUTTERWORTH3[1] * bw;
+  Complex poles[3] = { (p + d) / 2.0, (p - d) / 2.0, (r + sqrt(r * r - 4.0 * w0 * w0)) / 2.0 };
+  for (int i = 0; i < 3; i++) {
+    Complex z = bilinear(poles[i], fs);
+    filter.section[i].set(1.0, -1.0, z, std::conj(z));   // one zero at s = 0 and one at infinity
+  }
+  filter.normalize(fs / M_PI * atan(w0 / (2.0 * fs)), fs);
+}
+
+/// \brief 3rd order Butterworth high pass, 0 dB at fs/2
+static inline void designHighPass(IirFilter<2> &filter, double f, double fs) {
+  double wc = prewarp(f, fs);
+  Complex p = bilinear(wc / BUTTERWORTH3[0], fs);       // s -> wc / s
+  Complex r = bilinear(wc / BUTTERWORTH3[1], fs);
+  filter.section[0].set(1.0, 1.0, p, std::conj(p));
+  filter.section[1].set(1.0, 0.0, r, 0.0);
+  filter.normalize(fs / 2.0, fs);
+}
+
+/// \brief 4th order Butterworth low pass, 0 dB at DC
+static inline void designLowPass(IirFilter<2> &filter, double f, double fs) {
+  double wc = prewarp(f, fs);
+  for (int i = 0; i < 2; i++) {
+    double a = M_PI * (2 * i + 1) / 8.0;
+    Complex p = bilinear(Complex(-sin(a), cos(a)) * wc, fs);
+    filter.section[i].set(-1.0, -1.0, p, std::conj(p));
+  }
+  filter.normalize(0.0, fs);
+}
+
+/// \brief whole octaves, the top one fs/4 .. fs/2 and each next one half the frequency
+/// LEVELS octaves are band passes, one per decimation level, the top octave is a high pass
+/// the lowest level is not decimated further, so there are LEVELS - 1 low passes, LEVELS is at least 2
+template <uint8_t LEVELS>
+class OctaveFilterBank {
+  public:
+    static const uint8_t SIZE = LEVELS + 1;   ///< number of octaves
+
+    /// \param [in] fs sample frequency in Hz
+    OctaveFilterBank(double fs) {
+      designHighPass(_highPass, fs / 4.0, fs);
+      designBandPass(_bandPass[0], fs / 8.0, fs / 4.0, fs);
+      designLowPass(_lowPass[0], fs / 5.0, fs);        // -42 dB at 3/8 fs, which aliases into the next octave
+      // the same normalized filters at each level, the sample rate halves
+      for (uint8_t m = 1; m < LEVELS; m++)
+        _bandPass[m] = _bandPass[0];
+      for (uint8_t m = 1; m < LEVELS - 1; m++)
+        _lowPass[m] = _lowPass[0];
+    }
+
+    /// \brief mean square of each octave over a block, lowest octave first
+    /// \param [in,out] v block of n samples, used as work buffer for the decimated signal
+    /// \param [in] n number of samples, a multiple of 2^(LEVELS-1)
+    /// \param [out] energies SIZE mean squares
+    void process(float *v, uint16_t n, float *energies) {
+      energies[SIZE - 1] = _highPass.energy(v, n) / n;
+      for (uint8_t m = 0; m < LEVELS - 1; m++) {
+        // band pass, and the anti alias filter keeping every second sample in place
+        // both in one loop, the two filters do not depend on each other so their latencies overlap
+        IirFilter<3> &bandPass = _bandPass[m];
+        IirFilter<2> &lowPass = _lowPass[m];
+        float sum = 0.0;
+        for (uint16_t i = 0; i < n; i += 2) {
+          float x0 = v[i], x1 = v[i + 1];
+          float y0 = bandPass.process(x0);
+          v[i / 2] = lowPass.process(x0);
+          float y1 = bandPass.process(x1);
+          lowPass.process(x1);
+          sum += y0 * y0 + y1 * y1;
+        }
+        energies[LEVELS - 1 - m] = sum / n;
+        n /= 2;
+      }
+      energies[0] = _bandPass[LEVELS - 1].energy(v, n) / n;
+    }
+
+  private:
+    IirFilter<2> _highPass;
+    IirFilter<3> _bandPass[LEVELS];
+    IirFilter<2> _lowPass[LEVELS - 1];
+};
+
+#endif // __IIR_FILTERS_H_
@@ -53,8 +53,16 @@ extern void os_getDevKey (u1_t* buf) { parseHex( buf, appkey);}
 static osjob_t sendjob;
 static void (*workerCallback)(void) = NULL;     // worker callback
 static void (*rxCallback)(unsigned int, uint8_t*, unsigned int) = NULL;     // TTN receive handler
-//static void (*txCompleteCallback)(bool ok) = NULL;
+static void (*txCompleteCallback)(bool ok) = NULL;   // send or join request ready
 static bool txReady= false;
+static uint32_t txStartTime = 0;     // millis() of the last EV_TXSTART
+
+// send or join request is ready, ok is false when the join is not accepted
+static void txDone( bool ok) {
+  txReady = true;
+  if( txCompleteCallback != NULL)
+    txCompleteCallback( ok);
+}
 
 // Schedule TX every this many seconds (might become longer due to duty
 // cycle limitations).
@@ -121,7 +129,7 @@ void onEvent (ev_t ev) {
               }
               Serial.println();
               LMIC_setLinkCheckMode(0);
-              txReady = true;
+              txDone( true);
             }
             // Disable link check validation (automatically enabled
             // during join, but because slow data rates change max TX
@@ -153,7 +161,7 @@ void onEvent (ev_t ev) {
               if( rxCallback != NULL) 
                 rxCallback( LMIC.frame[LMIC.dataBeg-1], &LMIC.frame[LMIC.dataBeg], LMIC.dataLen);
             }
-            txReady = true;
+            txDone( true);
             // Schedule next transmission
             //os_setTimedCallback(&sendjob, os_getTime()+sec2osticks(TX_INTERVAL), do_send);
             break;
@@ -182,6 +190,7 @@ void onEvent (ev_t ev) {
         ||    break;
         */
         case EV_TXSTART:
+            txStartTime = millis();
             Serial.println(F("EV_TXSTART"));
             break;
         case EV_TXCANCELED:
@@ -192,7 +201,7 @@ void onEvent (ev_t ev) {
             break;
         case EV_JOIN_TXCOMPLETE:
             Serial.println(F("EV_JOIN_TXCOMPLETE: no JoinAccept"));
-            txReady = true;
+            txDone( false);
             break;
 
         default:
@@ -256,6 +265,14 @@ extern void loraSetWorker( void (*worker)( void)) {
    workerCallback = worker;
 }
 
+extern void loraSetTxComplete( void (*txComplete)(bool ok)) {
+   txCompleteCallback = txComplete;
+}
+
+extern uint32_t loraTxStartTime() {
+  return txStartTime;
+}
+
 extern void loraJoin() {
     // Check if there is not a current TX/RX job running
     if (LMIC.opmode & OP_TXRXPEND) 
@@ -291,6 +308,16 @@ extern void loraLoop( void) {
   os_runloop_once();
 }
 
+// time in ms that loraLoop() may be idle, at most maxMs
+// the DIO lines of the radio are polled, so during a TX/RX cycle or just before a scheduled job it must run continuously
+extern uint32_t loraIdleTime( uint32_t maxMs) {
+  if( LMIC.opmode & OP_TXRXPEND)
+    return 0;
+  if( os_queryTimeCriticalJobs( ms2osticks( maxMs)))
+    return 0;
+  return maxMs;
+}
+
 
 // ****************************************
 // somme convenient functions
@@ -20,8 +20,10 @@ extern bool loraSend( int port, uint8_t* mydata, int len);
 extern bool loraConnected();
 extern bool loraTxReady();
 extern void loraSetWorker( void (*worker)( void));
-//extern void loraSetTxComplete( void (*txComplete)(bool ok));
+extern void loraSetTxComplete( void (*txComplete)(bool ok));
 extern void loraSleep( int seconds);
 extern void loraLoop( void);
+extern uint32_t loraIdleTime( uint32_t maxMs);
+extern uint32_t loraTxStartTime();
 
 #endif // __LORA_H_
@@ -24,9 +24,14 @@
   --------------------------------------------------------------------*/
 
 #include <Arduino.h>
+#include <atomic>
+#include "events.h"
 #include "lora.h"
 #include "soundsensor.h"
 #include "measurement.h"
+#include "framequeue.h"
+#include "rollingleq.h"
+#include "capture.h"
 #include "config.h"
 #include "oled.h"
 static Oled oled;
@@ -35,29 +40,82 @@ static Oled oled;
 void Task0code( void * pvParameters );
 void loracallback( unsigned int port, unsigned char* msg, unsigned int len);
 void loraWorker( );
-static void composeMessage( Measurement& la, Measurement& lc, Measurement& lz);
+void loraTxComplete( bool ok);
+static void txComplete();
+static void composeMessage( const Measurement::Result& la, const Measurement::Result& lc, const Measurement::Result& lz, const RollingLeq& leq);
+static void consumeFrames();
+static void calculateAudio();
+#ifdef DSP_PROFILE_UPLINK
+static void composeDiagnostics();
+#endif
 
 static int cycleTime = CYCLETIME;
+
+// LoRa port of the payload, the spectrum length depends on the band layout
+#if defined(THIRD_OCTAVES)
+#define PAYLOAD_PORT 23     // 27 third octave bands
+#elif defined(IIR_FILTERS) && defined(WIDE_BAND)
+#define PAYLOAD_PORT 26     // 11 octave bands 16 Hz .. 16 kHz
+#elif defined(IIR_FILTERS)
+#define PAYLOAD_PORT 24     // 10 octave bands 16 Hz .. 8 kHz
+#elif defined(WIDE_BAND)
+#define PAYLOAD_PORT 25     // 10 octave bands 31.5 Hz .. 16 kHz
+#else
+#define PAYLOAD_PORT 22     // 9 octave bands 31.5 Hz .. 8 kHz
+#endif
 static char deveui[40];
 
+#ifdef DSP_PROFILE_UPLINK
+#ifndef DSP_PROFILE
+  #error DSP_PROFILE_UPLINK sends the profile of DSP_PROFILE
+#endif
+#define DIAGNOSTICS_PORT 30       // profile of the audio core
+#define DIAGNOSTICS_CYCLES 10     // reports per diagnostics message
+static int diagnosticsCycles = 0;
+static bool diagnosing = false;   // the diagnostics message is sent after the report
+#endif
+
 // Weighting lists
   static float aweighting[] = A_WEIGHTING;
   static float cweighting[] = C_WEIGHTING;
   static float zweighting[] = Z_WEIGHTING;
 
-// measurement buffers, filled by core 0, read by core 1
-  static Measurement aMeasurement( aweighting);
-  static Measurement cMeasurement( cweighting);
-  static Measurement zMeasurement( zweighting);
+// measurement results, published and read by core 1 only
+  static WeightingCurve aMeasurement( aweighting + FIRST_WEIGHTING, BANDS);
+  static WeightingCurve cMeasurement( cweighting + FIRST_WEIGHTING, BANDS);
+  static WeightingCurve zMeasurement( zweighting + FIRST_WEIGHTING, BANDS);
+// all weighting curves are summed up in one pass, the results are published in the curves
+  static WeightingBank weightings( BANDS);
+// LAeq over the last 1, 5, 15 and 60 min., from the A weighted energy of each frame
+  static RollingLeq rollingLeq;
+
+// audio frames from core 0 to core 1, 16 frames is at least 0.7 sec. of audio
+static FrameQueue<AudioFrame, 16> frames;
+static uint32_t nextSeq = 0;        // consumer side, expected sequence number
+static uint32_t framesLost = 0;     // consumer side, frames dropped because the queue was full
+#ifdef DSP_PROFILE
+static ProfileStats measurementProfile;   // core 1, measurement update of a frame
+static uint32_t measurementMean = 0;      // in us, of the previous report interval
+static uint32_t measurementMax = 0;
+static uint32_t lostFrames = 0;           // framesLost of the previous report interval
+#endif
  
 // Task 1 is the default ESP core 1, this one handles the LoRa TTN messages
 // Task 0 is the added ESP core 0, this one handles the audio, (read MEMS, FFT process and compose message)
 TaskHandle_t Task0;
 
-// task semaphores
-static bool audioRequest = false;
-static bool audioReady = false;
-static bool sound = false;
+// task flags
+static std::atomic<bool> sound( false);           // core 0 measures sound
+static std::atomic<bool> reportRequest( false);   // core 0 prints its audio statistics
+
+// task events, core 1 sleeps until one of these is set, see events.h
+static EventGroupHandle_t coreEvents;
+
+// worker state, the worker continues in txComplete() when LMIC is ready
+static bool joining = false;                      // join request pending, otherwise a send request
+static bool txOk = true;                          // result of the last request, false when a join got no JoinAccept
+static uint32_t joinFailures = 0;                 // joins without JoinAccept in a row
+static uint32_t reportTime = 0;                   // millis() when the report was composed
 
 // payloadbuffer
 unsigned char payload[80];
@@ -66,8 +124,24 @@ int payloadLength = 0;
 // create soundsensor
 static SoundSensor soundSensor;
 
+#ifdef RAW_CAPTURE
+// printf writes through Serial a line at a time, so the log stays between the frames of the raw capture
+static int serialWrite( void* cookie, const char* data, int size) {
+  (void)cookie;
+  return Serial.write( (const uint8_t*)data, size);
+}
+#endif
+
  void setup() {
+#ifdef RAW_CAPTURE
+  Serial.begin( CAPTURE_BAUD);
+  // the tasks created from here on take their stdout from the global one
+  _GLOBAL_REENT->_stdout = funopen( NULL, NULL, serialWrite, NULL, NULL);
+  setvbuf( _GLOBAL_REENT->_stdout, NULL, _IOLBF, 2 * CAPTURE_REPORT_SIZE);
+  stdout = _GLOBAL_REENT->_stdout;
+#else
   Serial.begin(115200); 
+#endif
   delay(100);
   // LoRa send LED
   pinMode(LED_BUILTIN, OUTPUT);
@@ -81,9 +155,20 @@ static SoundSensor soundSensor;
   oled.begin();
   oled.deveui = deveui; 
   oled.values( &aMeasurement, &cMeasurement, &zMeasurement);
+  oled.rolling( &rollingLeq);
   oled.status = "Starting";
   oled.update( );
 
+  weightings.add( &aMeasurement);
+  weightings.add( &cMeasurement);
+  weightings.add( &zMeasurement);
+  // a new frame every block, for the fast, slow and impulse time weighting
+  weightings.frameTime( (float)BLOCK_SIZE / SAMPLE_FREQ);
+#ifdef DSP_PROFILE
+  measurementProfile.budget( (uint64_t)BLOCK_SIZE * ESP.getCpuFreqMHz() * 1000000 / SAMPLE_FREQ);
+#endif
+  coreEvents = xEventGroupCreate();
+
   //create a task that will be executed in the Task1code() function, with priority 1 and executed on core 0
   xTaskCreatePinnedToCore(
                     Task0code,   // Task function.
@@ -97,11 +182,13 @@ static SoundSensor soundSensor;
 
 // do testread for 2 seconds
   sound = true;
-  delay(2000);
-  audioRequest = true;
-  while( !audioReady) 
-    delay(10);
-  audioReady = false;
+  uint32_t start = millis();
+  while( millis() - start < 2000) {
+    waitEvents( coreEvents, 100);
+    takeEvents( coreEvents);
+    consumeFrames();
+  }
+  calculateAudio();
   sound = false;
   oled.update();
  
@@ -109,6 +196,7 @@ static SoundSensor soundSensor;
   loraBegin( APPEUI, deveui, APPKEY);
   loraSetRxHandler( loracallback);    // set LoRa receive handler (downnlink)
   loraSetWorker( loraWorker);         // set Worker handler
+  loraSetTxComplete( loraTxComplete); // continue the worker when a request is ready
   loraSleep(1);                      // start worker 
   Serial.println("end setup");
 } 
@@ -121,6 +209,7 @@ void Task0code( void * pvParameters ){
   soundSensor.begin();
   soundSensor.offset( MIC_OFFSET );
   
+  uint32_t seq = 0;
   // main loop task 0
   while( true){
 
@@ -130,18 +219,21 @@ void Task0code( void * pvParameters ){
       // read chunk form MEMS and perform FFT, and sum energy in octave bins
       float* energy = soundSensor.readSamples();
 
-      // update
-      aMeasurement.update( energy);
-      cMeasurement.update( energy);
-      zMeasurement.update( energy);
-
-      // calculate audio result on request
-      if( audioRequest) {
-        audioRequest = false;
-        aMeasurement.calculate();
-        cMeasurement.calculate();
-        zMeasurement.calculate();
-        audioReady = true;    // signal worker task that audio result is ready
+      // hand off the frame to core 1, the measurements are updated there
+      AudioFrame frame;
+      frame.seq = seq++;
+      frame.time = millis();
+      memcpy( frame.energy, energy, sizeof( frame.energy));
+#ifdef IIR_FILTERS
+      memcpy( frame.weighted, soundSensor.weighted(), sizeof( frame.weighted));
+#endif
+      frames.push( frame);    // when the queue is full the frame is dropped, core 1 sees a gap in seq
+      xEventGroupSetBits( coreEvents, FRAME_READY);     // wake up core 1
+
+      // CPU headroom of the audio core and capture overruns, the DSP must keep up with the capture
+      if( reportRequest) {
+        reportRequest = false;
+        soundSensor.report();
       }
     }
     else {
@@ -152,6 +244,49 @@ void Task0code( void * pvParameters ){
   }
 }
 
+// update the measurements with the frames from core 0, called from core 1 only
+static void consumeFrames() {
+  AudioFrame frame;
+  while( frames.pop( frame)) {
+    framesLost += frame.seq - nextSeq;
+    nextSeq = frame.seq + 1;
+    PROFILE_START( update);
+#ifdef IIR_FILTERS
+    weightings.update( frame.energy, frame.weighted, WEIGHTED_CURVES);   // curves 0 and 1 are A and C
+#else
+    weightings.update( frame.energy);
+#endif
+    rollingLeq.add( weightings.energy( 0), frame.time);    // curve 0 is A weighting
+    PROFILE_STOP( measurementProfile, update);
+  }
+  rollingLeq.advance( millis());    // the seconds go on when the sound measurement is stopped
+}
+
+// calculate the audio result of all frames since the previous result
+static void calculateAudio() {
+  consumeFrames();
+  weightings.calculate();
+#ifdef RAW_CAPTURE
+  // the results in bits after nextSeq frames, native/replay.cpp compares them with a replay of the capture
+  static char line[ CAPTURE_REPORT_SIZE];
+  captureReport( line, nextSeq, aMeasurement.result(), cMeasurement.result(), zMeasurement.result(), BANDS);
+  printf( "%s\n", line);
+#endif
+  if( framesLost > 0)
+    printf("audio frames lost=%u\n", framesLost);
+#ifdef DSP_PROFILE
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  printf("measurement profile at %u MHz, histogram in tenths of the frame time\n", mhz);
+  measurementProfile.print( "measurement", mhz);
+  measurementMean = measurementProfile.mean() / mhz;
+  measurementMax = measurementProfile.max() / mhz;
+  measurementProfile.reset();
+  lostFrames = framesLost;
+#endif
+  framesLost = 0;
+  reportRequest = true;
+}
+
 // LoRa receive handler (downnlink)
 void loracallback( unsigned int port, unsigned char* msg, unsigned int len) {
   printf("lora download message received port=%d len=%d\n", port, len);
@@ -177,10 +312,14 @@ void loracallback( unsigned int port, unsigned char* msg, unsigned int len) {
 }
 
 // compose payload message
-static void composeMessage( Measurement& la, Measurement& lc, Measurement& lz) {
+static void composeMessage( const Measurement::Result& la, const Measurement::Result& lc, const Measurement::Result& lz, const RollingLeq& leq) {
   // find max value to compress values [0 .. max] in an unsigned byte from [0 .. 255]
   float max = ( la.max > lc.max) ? la.max : lc.max;
   max = ( lz.max > max) ? lz.max : max;
+  for ( int j = 0; j < ROLLING_WINDOWS; j++)
+    max = ( leq.leq( j) > max) ? leq.leq( j) : max;     // a rolling window can hold louder intervals
+  max = ( la.imax > max) ? la.imax : max;               // a time weighted level can hold a louder previous interval
+  max = ( la.l5 > max) ? la.l5 : max;                   // a statistical level is the middle of a histogram bin
 
   float c = 255.0 / max;
   int i=0;
@@ -198,15 +337,62 @@ static void composeMessage( Measurement& la, Measurement& lc, Measurement& lz) {
   payload[ i++] = round(c * lz.max);
   payload[ i++] = round(c * lz.avg);
 
-  for ( int j = 0; j < OCTAVES; j++) {
+  for ( int j = 0; j < BANDS; j++) {
     payload[ i++] = round(c * lz.spectrum[j]);
   }
 
+  // rolling LAeq 1, 5, 15 and 60 min.
+  for ( int j = 0; j < ROLLING_WINDOWS; j++) {
+    payload[ i++] = round(c * leq.leq( j));
+  }
+
+  // LAFmax, LASmax and LAImax
+  payload[ i++] = round(c * la.fmax);
+  payload[ i++] = round(c * la.smax);
+  payload[ i++] = round(c * la.imax);
+
+  // statistical levels LA5, LA10, LA50, LA90 and LA95
+  payload[ i++] = round(c * la.l5);
+  payload[ i++] = round(c * la.l10);
+  payload[ i++] = round(c * la.l50);
+  payload[ i++] = round(c * la.l90);
+  payload[ i++] = round(c * la.l95);
+
   payloadLength = i;
   if( payloadLength > 51)   // max TTN message length
     printf( "message to big length=%d\n", payloadLength);
 }
 
+#ifdef DSP_PROFILE_UPLINK
+// little endian, like the downlink values, saturated at 65535
+static int putWord( int i, uint32_t value) {
+  if( value > 0xFFFF)
+    value = 0xFFFF;
+  payload[ i++] = value & 0xFF;
+  payload[ i++] = value >> 8;
+  return i;
+}
+
+// compose the diagnostics message, the profile of the previous report interval
+static void composeDiagnostics() {
+  ProfileSummary profile = soundSensor.profile();
+  int i = 0;
+  float duty = round( 200.0 * profile.duty);                 // 0.5% steps
+  float headroom = round( 100.0 * profile.headroom);         // 1% steps, negative when a frame took too long
+  payload[ i++] = ( duty > 255) ? 255 : duty;
+  payload[ i++] = (int8_t)(( headroom < -128) ? -128 : headroom);
+  for ( int j = 0; j < PROFILE_STAGES; j++) {                // read, convert, transform, bands, frame
+    i = putWord( i, profile.mean[j] / 10);                   // 10 us steps
+    i = putWord( i, profile.max[j] / 10);
+  }
+  i = putWord( i, measurementMean);                          // us
+  i = putWord( i, measurementMax);
+  i = putWord( i, profile.overruns);
+  i = putWord( i, lostFrames);
+  payloadLength = i;
+}
+#endif
+
 // called from LoRa Task (task1), each cycle time
 void loraWorker( ) {
   printf("Worker\n");
@@ -214,11 +400,7 @@ void loraWorker( ) {
   if( loraConnected()) { 
     sound = true;
     oled.status = "TTN Connected";
-    audioRequest = true;  // signal audiotask to compose an audio report
-   
-    while( !audioReady)  // wait for Task 0 to be ready
-      loraLoop();    
-    audioReady = false;
+    calculateAudio();     // audio report of all frames received so far
     digitalWrite( LED_BUILTIN, HIGH);
    
           // save values for oled display
@@ -227,15 +409,18 @@ void loraWorker( ) {
     //aMeasurement.print();
     //cMeasurement.print();
     //zMeasurement.print();
-    composeMessage( aMeasurement, cMeasurement, zMeasurement);
+    Measurement::Result la = aMeasurement.result();
+    printf("LAeq=%.1f LA5=%.1f LA10=%.1f LA50=%.1f LA90=%.1f LA95=%.1f LAFmax=%.1f\n",
+      la.avg, la.l5, la.l10, la.l50, la.l90, la.l95, la.fmax);
+    composeMessage( aMeasurement.result(), cMeasurement.result(), zMeasurement.result(), rollingLeq);
     printf("send message len=%d core=%d\n", payloadLength, xPortGetCoreID());
-    loraSend( 22, (unsigned char*)payload, payloadLength);  // use port 22
-    // wait until lora request is ready within timeout
-    //long start = millis();
-    while ( !loraTxReady() /*&& millis() - start < 100000 */ )
-      loraLoop(); 
-    digitalWrite( LED_BUILTIN, LOW);
-    loraSleep( cycleTime);
+    joining = false;
+    reportTime = millis();
+    if( !loraSend( PAYLOAD_PORT, (unsigned char*)payload, payloadLength)) {
+      digitalWrite( LED_BUILTIN, LOW);
+      loraSleep( cycleTime);    // LMIC still busy, skip this report
+    }
+    // continues in txComplete() when the lora request is ready
   }
   else {   // lora not connected so do a (re)join
     sound = false;
@@ -243,27 +428,72 @@ void loraWorker( ) {
     printf("loraJoin\n");
     oled.status = "TTN Joining..";
     oled.update();
+    joining = true;
     loraJoin(); 
-   // wait until lora request is ready within timeout
-    //long start = millis();
-    while ( !loraTxReady() /*&& millis() - start < 1000*/  )
-      loraLoop(); 
-    digitalWrite( LED_BUILTIN, LOW);
-    if( loraConnected()) { 
-      oled.status = "TTN Connected"; 
-      sound = true;
-      oled.update();
+    // continues in txComplete() when the lora request is ready
+  }
+}
+
+// called from the LMIC event callback when the send or join request of the worker is ready
+// LMIC must not be called from its callback, so the work is done in loop(), ok is false when a join failed
+// the callback runs in loraLoop(), in loop() like txComplete(), so txOk needs no lock
+void loraTxComplete( bool ok) {
+  txOk = ok;
+  xEventGroupSetBits( coreEvents, TX_COMPLETE);
+}
+
+// called from loop() after loraTxComplete(), the next request or the sleep until the next report
+static void txComplete() {
+  digitalWrite( LED_BUILTIN, LOW);
+  if( !joining) {
+#ifdef DSP_PROFILE_UPLINK
+    if( diagnosing) {    // the diagnostics message after the report is sent
+      diagnosing = false;
       loraSleep( cycleTime);
+      return;
     }
-    else {
-      oled.status = "TTN Join Failed";
-      oled.update();
-      loraSleep( 10);  // sleep a short time to retry a join again
+#endif
+    printf("report to TX latency=%u ms\n", loraTxStartTime() - reportTime);
+#ifdef DSP_PROFILE_UPLINK
+    // every DIAGNOSTICS_CYCLES reports the profile follows the report
+    if( ++diagnosticsCycles >= DIAGNOSTICS_CYCLES) {
+      diagnosticsCycles = 0;
+      composeDiagnostics();
+      printf("send diagnostics len=%d\n", payloadLength);
+      if( loraSend( DIAGNOSTICS_PORT, (unsigned char*)payload, payloadLength)) {
+        diagnosing = true;
+        digitalWrite( LED_BUILTIN, HIGH);
+        return;   // continues here when the lora request is ready
+      }
     }
+#endif
+    loraSleep( cycleTime);
+  }
+  else if( txOk) { 
+    joinFailures = 0;
+    oled.status = "TTN Connected"; 
+    sound = true;
+    oled.update();
+    loraSleep( cycleTime);
+  }
+  else {
+    printf("join failed, no JoinAccept, %u in a row\n", ++joinFailures);
+    oled.status = "TTN Join Failed";
+    oled.update();
+    loraSleep( 10);  // sleep a short time to retry a join again
   }
 }
 
 // main loop task 1 (esp default)
+// LMIC is only polled continuously when it needs it, otherwise the task sleeps until the next audio frame
+// or the end of a lora request
 void loop() {
    loraLoop();
+   EventBits_t events = takeEvents( coreEvents);
+   consumeFrames();
+   if( events & TX_COMPLETE)
+     txComplete();
+   uint32_t idle = loraIdleTime( 100);
+   if( idle > 0)
+     waitEvents( coreEvents, idle);
 }
@@ -25,58 +25,202 @@
 #include <Arduino.h>
 #include "measurement.h"
 
-Measurement::Measurement( float* weighting) {
+WeightingCurve::WeightingCurve( float* weighting, int bands) : _seq( 0) {
+  memset( _results, 0, sizeof( _results));
+  this->bands = (bands > MAX_BANDS) ? MAX_BANDS : bands;
   _weighting = weighting;
-  for ( int i = 0; i < OCTAVES; i++)
+  for ( int i = 0; i < this->bands; i++)
     _weighting[i] = pow(10, _weighting[i] / 10.0);  // convert dB constants to energy level constants
+}
+
+void WeightingCurve::publish( const float* spectrum, float sum, float min, float max, int n,
+                              const LevelHistogram& levels, float fmax, float smax, float imax) {
+  uint32_t seq = _seq.load( std::memory_order_relaxed);   // even, twice the number of published results
+  _seq.store( seq + 1, std::memory_order_relaxed);         // odd while the next result is written
+  std::atomic_thread_fence( std::memory_order_release);   // a reader that sees a new value sees the odd count too
+  Result& r = _results[ ((seq >> 1) + 1) & 1];            // not the buffer of the last result
+  r.avg = decibel( sum / (float)n);           // calculate average and convert to dB
+  r.min = decibel( min);                      // convert to dB
+  r.max = decibel( max); 
+  r.n = n;
+  r.l5 = levels.exceeded( 5.0);
+  r.l10 = levels.exceeded( 10.0);
+  r.l50 = levels.exceeded( 50.0);
+  r.l90 = levels.exceeded( 90.0);
+  r.l95 = levels.exceeded( 95.0);
+  r.fmax = decibel( fmax);
+  r.smax = decibel( smax);
+  r.imax = decibel( imax);
+
+  // calculate average for each band and convert to dB
+  for ( int i = 0; i < bands; i++) {
+    float val = spectrum[i] / (float)n;       // energy average
+    r.spectrum[i] = decibel( val);            // convert to dB
+  }
+  _seq.store( seq + 2, std::memory_order_release);   // publish
+}
+
+// copy the last result, its buffer is written again from count (seq & ~1) + 3 on, the
+// start of the publish after the next one, when the count got there the copy can be torn, so try again
+WeightingCurve::Result WeightingCurve::result() const {
+  Result r;
+  uint32_t seq;
+  do {
+    seq = _seq.load( std::memory_order_acquire);
+    r = _results[ (seq >> 1) & 1];
+    std::atomic_thread_fence( std::memory_order_acquire);
+  } while( _seq.load( std::memory_order_relaxed) - (seq & ~1u) > 2);
+  return r;
+}
+
+float WeightingCurve::decibel(float v) {
+  return 10.0 * log10(v);                    // for energy this should be 20.0 * log...  to be checked!
+}
+
+void WeightingCurve::print() {
+  Result r = result();
+  printf("count=%d min=%.1f max=%.1f avg=%.1f L5=%.1f L10=%.1f L50=%.1f L90=%.1f L95=%.1f Fmax=%.1f Smax=%.1f Imax=%.1f  =>",
+    r.n, r.min, r.max, r.avg, r.l5, r.l10, r.l50, r.l90, r.l95, r.fmax, r.smax, r.imax);
+  for (int i = 0; i < bands; i++)
+    printf(" %.1f", r.spectrum[i]);
+  printf("\n");
+}
+
+Measurement::Measurement( float* weighting, int bands) : WeightingCurve( weighting, bands) {
+  frameTime( 0.09);                           // 2048 samples at 22627 Hz
   reset();
 }
 
+void Measurement::frameTime( float frameTime) {
+  _fast.begin( TAU_FAST, TAU_FAST, frameTime);
+  _slow.begin( TAU_SLOW, TAU_SLOW, frameTime);
+  _impulse.begin( TAU_IMPULSE, TAU_IMPULSE_DECAY, frameTime);
+}
+
 void Measurement::reset() {
-  _avg = 0.0;
+  _avg.reset();
   _n = 0;
   _min = FLT_MAX;
-  _max = FLT_MIN;
+  _max = 0.0;                                  // energies are never negative
+  _levels.reset();
+  _fast.max = _slow.max = _impulse.max = 0.0;   // the levels run on, the max is per interval
 
-  for ( int i = 0; i < OCTAVES; i++)
-    _spectrum[i] = 0.0;
+  for ( int i = 0; i < bands; i++)
+    _spectrum[i].reset();
 }
 
 void Measurement::update( float* energies ) {
   _n++;
   float sum = 0.0;                             // sum in energy for this measurement
-  for (int i = 0; i < OCTAVES; i++) {
+  for (int i = 0; i < bands; i++) {
     float v = energies[i] * _weighting[i];
-    _spectrum[i] += v;                          // sum energy per band for all measurements
+    _spectrum[i].add( v);                       // sum energy per band for all measurements
     sum += v;
   }
-  _avg += sum;
+  _avg.add( sum);
+  _levels.add( sum);
+  _fast.add( sum);
+  _slow.add( sum);
+  _impulse.add( sum);
 
   if ( _max < sum) _max = sum;
   if ( _min > sum) _min = sum;
 }
 
 void Measurement::calculate() {
-  avg = decibel( _avg / (float)_n);           // calculate average and convert to dB
-  min = decibel( _min);                       // convert to dB
-  max = decibel( _max); 
-  n = _n;                      // convert to dB
+  float spectrum[MAX_BANDS];
+  for ( int i = 0; i < bands; i++)
+    spectrum[i] = _spectrum[i].sum;
+  publish( spectrum, _avg.sum, _min, _max, _n, _levels, _fast.max, _slow.max, _impulse.max);
+  reset();
+}
 
-  // calculate average for each band and convert to dB
-  for ( int i = 0; i < OCTAVES; i++) {
-    float val = _spectrum[i] / (float)_n;     // energy average
-    spectrum[i] = decibel( val);              // convert to dB
-  }
+WeightingBank::WeightingBank( int bands) {
+  _bands = (bands > MAX_BANDS) ? MAX_BANDS : bands;
+  _curves = 0;
+  for ( int i = 0; i < MAX_BANDS; i++)
+    for ( int c = 0; c < MAX_CURVES; c++)
+      _weights[i][c] = 0.0;
+  frameTime( 0.09);                           // 2048 samples at 22627 Hz
   reset();
 }
 
-float Measurement::decibel(float v) {
-  return 10.0 * log10(v);                    // for energy this should be 20.0 * log...  to be checked!
+bool WeightingBank::add( WeightingCurve* curve) {
+  if ( _curves >= MAX_CURVES)
+    return false;
+  const float* weighting = curve->weighting();
+  for ( int i = 0; i < _bands && i < curve->bands; i++)
+    _weights[i][_curves] = weighting[i];
+  _curve[_curves++] = curve;
+  return true;
 }
 
-void Measurement::print() {
-  printf("count=%d min=%.1f max=%.1f avg=%.1f  =>", n, min, max, avg);
-  for (int i = 0; i < OCTAVES; i++)
-    printf(" %.1f", spectrum[i]);
-  printf("\n");
+void WeightingBank::frameTime( float frameTime) {
+  static const float tauRise[TIME_WEIGHTINGS] = { TAU_FAST, TAU_SLOW, TAU_IMPULSE };
+  static const float tauDecay[TIME_WEIGHTINGS] = { TAU_FAST, TAU_SLOW, TAU_IMPULSE_DECAY };
+  for ( int t = 0; t < TIME_WEIGHTINGS; t++) {
+    _rise[t] = exp( -frameTime / tauRise[t]);
+    _decay[t] = exp( -frameTime / tauDecay[t]);
+    for ( int c = 0; c < MAX_CURVES; c++)
+      _level[t][c] = 0.0;
+  }
+}
+
+void WeightingBank::reset() {
+  _n = 0;
+  for ( int c = 0; c < MAX_CURVES; c++) {
+    _last[c] = 0.0;
+    _sum[c] = _carry[c] = 0.0;
+    _min[c] = FLT_MAX;
+    _max[c] = 0.0;                            // energies are never negative
+    _levels[c].reset();
+  }
+  for ( int t = 0; t < TIME_WEIGHTINGS; t++)
+    for ( int c = 0; c < MAX_CURVES; c++)
+      _peak[t][c] = 0.0;                      // the levels run on, the max is per interval
+  for ( int i = 0; i < MAX_BANDS; i++)
+    _spectrum[i].reset();
+}
+
+void WeightingBank::update( const float* energies, const float* weighted, int count) {
+  _n++;
+  float sum[MAX_CURVES] = { 0.0 };            // sum in energy per curve for this measurement
+  for ( int i = 0; i < _bands; i++) {
+    float e = energies[i];
+    _spectrum[i].add( e);                     // sum energy per band for all measurements, weighted in calculate()
+    for ( int c = 0; c < MAX_CURVES; c++)
+      sum[c] += e * _weights[i][c];
+  }
+  for ( int c = 0; c < count; c++)
+    sum[c] = weighted[c];
+
+  for ( int c = 0; c < MAX_CURVES; c++) {
+    float v = sum[c];
+    _last[c] = v;
+    float y = v - _carry[c];                  // Kahan sum, see KahanSum
+    float t = _sum[c] + y;
+    _carry[c] = (t - _sum[c]) - y;
+    _sum[c] = t;
+    if ( _max[c] < v) _max[c] = v;
+    if ( _min[c] > v) _min[c] = v;
+  }
+  for ( int t = 0; t < TIME_WEIGHTINGS; t++)
+    for ( int c = 0; c < _curves; c++) {
+      float k = ( sum[c] > _level[t][c]) ? _rise[t] : _decay[t];
+      _level[t][c] = k * _level[t][c] + (1.0f - k) * sum[c];
+      if ( _peak[t][c] < _level[t][c]) _peak[t][c] = _level[t][c];
+    }
+  for ( int c = 0; c < _curves; c++)
+    _levels[c].add( sum[c]);
+}
+
+void WeightingBank::calculate() {
+  float spectrum[MAX_BANDS];
+  for ( int c = 0; c < _curves; c++) {
+    for ( int i = 0; i < _bands; i++)
+      spectrum[i] = _spectrum[i].sum * _weights[i][c];
+    _curve[c]->publish( spectrum, _sum[c], _min[c], _max[c], _n,
+                        _levels[c], _peak[FAST][c], _peak[SLOW][c], _peak[IMPULSE][c]);
+  }
+  reset();
 }
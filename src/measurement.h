@@ -46,30 +46,114 @@
 #ifndef __MEASUREMENT_H_
 #define __MEASUREMENT_H_
 
-#define OCTAVES 9
+#include <stdint.h>
+#include <atomic>
+#include "bands.h"
+#include "histogram.h"
 
-// A, C and Z weighting curves from in steps of whole octaves
-// spectrum           31,5Hz  63Hz  125Hz 250Hz  500Hz 1kHz 2kHz 4kHz 8kHz 
-#define A_WEIGHTING { -39.4, -26.2, -16.1, -8.6, -3.2, 0.0, 1.2, 1.0, -1.1 };
-#define C_WEIGHTING {  -3.0,  -0.8,  -0.2,  0.0,  0.0, 0.0, 0.2, 0.3, -3.0 };
-#define Z_WEIGHTING {   0.0,  -0.0,  -0.0,  0.0,  0.0, 0.0, 0.0, 0.0,  0.0 };
+#ifdef THIRD_OCTAVES
+// A, C and Z weighting curves in steps of third octaves
+// spectrum            25Hz  31,5Hz  40Hz   50Hz   63Hz   80Hz  100Hz  125Hz  160Hz  200Hz  250Hz 315Hz 400Hz 500Hz 630Hz 800Hz 1kHz 1k25 1k6  2kHz 2k5  3k15 4kHz 5kHz  6k3  8kHz 10kHz
+#define A_WEIGHTING { -44.7, -39.4, -34.6, -30.2, -26.2, -22.5, -19.1, -16.1, -13.4, -10.9, -8.6, -6.6, -4.8, -3.2, -1.9, -0.8, 0.0, 0.6, 1.0, 1.2, 1.3, 1.2, 1.0, 0.5, -0.1, -1.1, -2.5 };
+#define C_WEIGHTING {  -4.4,  -3.0,  -2.0,  -1.3,  -0.8,  -0.5,  -0.3,  -0.2,  -0.1,   0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0, 0.0, 0.0,-0.1,-0.2,-0.3,-0.5,-0.8,-1.3, -2.0, -3.0, -4.4 };
+#define Z_WEIGHTING {   0.0,   0.0,   0.0,   0.0,   0.0,   0.0,   0.0,   0.0,   0.0,   0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,  0.0,  0.0,  0.0 };
+#define FIRST_WEIGHTING 0   ///< the tables start at the first band
+#else
+// A, C and Z weighting curves in steps of whole octaves, all octaves from 16 Hz to 16 kHz
+// spectrum            16Hz  31,5Hz  63Hz  125Hz 250Hz  500Hz 1kHz 2kHz 4kHz 8kHz  16kHz
+#define A_WEIGHTING { -56.7, -39.4, -26.2, -16.1, -8.6, -3.2, 0.0, 1.2, 1.0, -1.1, -6.6 };
+#define C_WEIGHTING {  -8.5,  -3.0,  -0.8,  -0.2,  0.0,  0.0, 0.0, 0.2, 0.3, -3.0, -8.5 };
+#define Z_WEIGHTING {   0.0,   0.0,  -0.0,  -0.0,  0.0,  0.0, 0.0, 0.0, 0.0,  0.0,  0.0 };
+#define FIRST_WEIGHTING FIRST_OCTAVE   ///< the tables start at 16 Hz, the first band is FIRST_OCTAVE
+#endif
 
+#define MAX_CURVES 4        ///< weighting curves in a WeightingBank, A, C, Z and one spare
 
-class Measurement {
+// IEC 61672 time constants in seconds
+#define TAU_FAST 0.125      ///< F, fast
+#define TAU_SLOW 1.0        ///< S, slow
+#define TAU_IMPULSE 0.035   ///< I, impulse, rising
+#define TAU_IMPULSE_DECAY 1.5  ///< I, impulse, falling
+
+/// \brief float sum with Kahan compensation
+/// the rounding error of each addition is carried to the next one, so a small energy
+/// added to a large sum is not lost, also after hours of measurements
+struct KahanSum {
+  float sum;                ///< compensated sum
+  float carry;              ///< rounding error of the last addition, to be subtracted
+
+  void reset() { sum = 0.0; carry = 0.0; }
+  void add( float v) {
+    float y = v - carry;
+    float t = sum + y;
+    carry = (t - sum) - y;
+    sum = t;
+  }
+};
+
+/// \brief exponential time weighting of the energy, for LAFmax, LASmax and LAImax
+/// the energy is constant during a frame, so one step per frame is exact:
+/// level = k * level + (1 - k) * energy with k = exp(-frameTime / tau),
+/// within the frame the level moves towards the energy, so the max is at the end of a frame
+struct TimeWeighting {
+  float level;              ///< time weighted energy
+  float max;                ///< max level in this interval
+  float rise, decay;        ///< k for a rising and a falling level
+
+  /// \param [in] tauRise, tauDecay time constants in seconds, the same except for impulse
+  /// \param [in] frameTime time between two frames in seconds
+  void begin( float tauRise, float tauDecay, float frameTime) {
+    rise = exp( -frameTime / tauRise);
+    decay = exp( -frameTime / tauDecay);
+    level = 0.0;
+    max = 0.0;
+  }
+  void add( float energy) {
+    float k = ( energy > level) ? rise : decay;
+    level = k * level + (1.0f - k) * energy;
+    if ( max < level) max = level;
+  }
+};
+
+
+/// \brief weighting curve of a measurement and the results published for it
+/// the results are summed up by a Measurement for one curve or by a WeightingBank for all curves
+class WeightingCurve {
   public:
+    /// \brief result of one measurement interval, in dB
+    struct Result {
+      float spectrum[MAX_BANDS];  ///< Array of results in dB per frequency band.
+      float avg, min, max;        ///< avg, min and max result value in dB.
+      float l5, l10, l50, l90, l95;  ///< statistical levels in dB, LN is exceeded during N% of the measurements
+      float fmax, smax, imax;     ///< max of the fast, slow and impulse time weighted level in dB
+      int n;                      ///< number of measurements
+    };
+
     /// \brief constructor
     /// \param [in] weighting Weighting factor for class
-    Measurement( float* weighting);
-    
-    /// \brief Reset
-    void reset();
-    
-    /// \brief Update energies?
-    /// \param [in] energies ?
-    void update( float* energies);
-    
-    /// \param calculate result
-    void calculate();
+    /// \param [in] bands number of frequency bands, length of weighting
+    WeightingCurve( float* weighting, int bands = BANDS);
+
+    /// \brief consistent copy of the last published result, can be called from any task
+    /// retries only when the publish after the next one starts during the copy.
+    /// All readers, the worker and the display, now run on core 1 with calculate(), so they
+    /// never meet a publish; the seqlock keeps a reader on another core safe.
+    Result result() const;
+
+    /// \brief publish the result of an interval
+    /// the result is written in the buffer that readers do not use, so this never waits for a reader
+    /// \param [in] spectrum weighted energy per band, summed over n measurements
+    /// \param [in] sum weighted energy of all bands, summed over n measurements
+    /// \param [in] min min weighted energy of one measurement
+    /// \param [in] max max weighted energy of one measurement
+    /// \param [in] n number of measurements
+    /// \param [in] levels histogram of the weighted energies of the measurements
+    /// \param [in] fmax, smax, imax max of the fast, slow and impulse time weighted energy
+    void publish( const float* spectrum, float sum, float min, float max, int n,
+                  const LevelHistogram& levels, float fmax, float smax, float imax);
+
+    /// \brief weighting factors in energy per band
+    const float* weighting() const { return _weighting; }
     
     /// \brief calculate dB value for power
     /// \param [in] v Value in power to be converted in to dB.
@@ -80,15 +164,102 @@ class Measurement {
     void print();
 
    // public members
-    float spectrum[OCTAVES];  ///< Array of results in dB per frequency band.
-    float avg, min, max;      ///< avg, min and max result value in dB.
-    int n;
- 
-  private:
-    float _spectrum[OCTAVES];  ///< working array in energy per frequency band.
-    float _avg, _min, _max;   ///< working avg, min , max based in energy.
+    int bands;                ///< number of frequency bands
+
+  protected:
     float* _weighting;        ///< Weighting factors
+
+  private:
+    Result _results[2];       ///< published results, double buffered
+    std::atomic<uint32_t> _seq;  ///< twice the number of published results, odd during a publish, the last one is in _results[(_seq >> 1) & 1]
+};
+
+/// \brief sums up the energies of one weighting curve
+class Measurement : public WeightingCurve {
+  public:
+    /// \brief constructor
+    /// \param [in] weighting Weighting factor for class
+    /// \param [in] bands number of frequency bands, length of weighting
+    Measurement( float* weighting, int bands = BANDS);
+
+    /// \brief set the time between two measurements for the time weighted levels
+    /// \param [in] frameTime time between two frames in seconds
+    void frameTime( float frameTime);
+    
+    /// \brief Reset
+    void reset();
+    
+    /// \brief Update energies?
+    /// \param [in] energies ?
+    void update( float* energies);
+    
+    /// \brief calculate result and publish it, then reset for the next interval
+    void calculate();
+
+  private:
+    KahanSum _spectrum[MAX_BANDS];  ///< working array in energy per frequency band.
+    KahanSum _avg;            ///< working sum of the energies for avg
+    float _min, _max;         ///< working min , max based in energy.
+    LevelHistogram _levels;   ///< levels of the measurements in this interval
+    TimeWeighting _fast, _slow, _impulse;  ///< time weighted levels, these run on over the intervals
     int    _n;                ///< number of measurements
 }; 
 
+/// \brief sums up the energies of all weighting curves in one pass
+///
+/// The weighting factors are constant per band, so the spectrum is summed up once,
+/// unweighted, and weighted per curve when the result is published. Per measurement
+/// only the weighted energy of all bands differs per curve: the factors are the columns
+/// of a band matrix, per band the energy is read once and multiplied with a row of
+/// MAX_CURVES factors, unused curves have factor 0.0. The working values of the curves,
+/// the sums, min, max and time weighted levels, are arrays indexed by curve, next to a
+/// level histogram per curve. The results are published in the WeightingCurve of each curve.
+class WeightingBank {
+  public:
+    /// \brief constructor
+    /// \param [in] bands number of frequency bands
+    WeightingBank( int bands = BANDS);
+
+    /// \brief add a weighting curve, the results of the curve are published in it
+    /// \return false when there are already MAX_CURVES curves
+    bool add( WeightingCurve* curve);
+
+    /// \brief set the time between two measurements for the time weighted levels
+    /// \param [in] frameTime time between two frames in seconds
+    void frameTime( float frameTime);
+
+    /// \brief Reset
+    void reset();
+
+    /// \brief weigh the band energies of one measurement for all curves and sum them up
+    /// \param [in] energies energy per band
+    /// \param [in] weighted energy of the first curves from weighting filters, used instead of the weighted sum
+    /// of the bands, the spectrum is still weighted per band
+    /// \param [in] count number of curves in weighted
+    void update( const float* energies, const float* weighted = NULL, int count = 0);
+
+    /// \brief publish the result of each curve in its WeightingCurve, then reset for the next interval
+    void calculate();
+
+    /// \brief weighted energy of a curve in the last update, curves are numbered in the order they are added
+    float energy( int curve) const { return _last[curve]; }
+
+  private:
+    enum { FAST, SLOW, IMPULSE, TIME_WEIGHTINGS };
+
+    float _weights[MAX_BANDS][MAX_CURVES];   ///< weighting factors in energy, band major
+    KahanSum _spectrum[MAX_BANDS];           ///< working array in unweighted energy per band
+    float _sum[MAX_CURVES], _carry[MAX_CURVES];  ///< working sum of all bands per curve, Kahan compensated
+    float _min[MAX_CURVES], _max[MAX_CURVES];
+    float _last[MAX_CURVES];                 ///< weighted energy of the last update
+    float _level[TIME_WEIGHTINGS][MAX_CURVES];  ///< time weighted energy, runs on over the intervals
+    float _peak[TIME_WEIGHTINGS][MAX_CURVES];   ///< max time weighted energy in this interval
+    float _rise[TIME_WEIGHTINGS], _decay[TIME_WEIGHTINGS];  ///< k of the time weightings, see TimeWeighting
+    LevelHistogram _levels[MAX_CURVES];      ///< levels of the measurements in this interval
+    WeightingCurve* _curve[MAX_CURVES];
+    int _bands;
+    int _curves;
+    int _n;                                  ///< number of measurements
+};
+
 #endif //__MEASUREMENT_H_
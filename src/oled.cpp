@@ -32,12 +32,17 @@ void Oled::begin() {
   }
 }
 
-void Oled::values( Measurement* la, Measurement* lc, Measurement* lz) {
+void Oled::values( WeightingCurve* la, WeightingCurve* lc, WeightingCurve* lz) {
   _la = la;
   _lc = lc;
   _lz = lz;
 }
 
+// rolling LA equivalent levels, shown instead of the deveui when there are measurements
+void Oled::rolling( RollingLeq* leq) {
+  _leq = leq;
+}
+
 
 void Oled::update( ) {
   //printf( "showValues status=%s\n", status);
@@ -45,13 +50,25 @@ void Oled::update( ) {
   //display->setRotation( 2);  // rotate 180 degrees
   display->setTextColor(WHITE);
   display->setTextSize(1); 
-  if( _la != NULL && _la->avg > 0.0) {
-    display->setCursor(0, 0);  display->printf( "      avg  min  max");
-    display->setCursor(0, 10);  display->printf("dB(A) %.1f %.1f %.1f", _la->avg, _la->min, _la->max), 
-    display->setCursor(0, 20);  display->printf("dB(C) %.1f %.1f %.1f", _lc->avg, _lc->min, _lc->max);
-    display->setCursor(0, 30);  display->printf("dB(Z) %.1f %.1f %.1f", _lz->avg, _lz->min, _lz->max);
+  if( _la != NULL) {
+    // consistent copies of the last results
+    Measurement::Result la = _la->result();
+    Measurement::Result lc = _lc->result();
+    Measurement::Result lz = _lz->result();
+    if( la.avg > 0.0) {
+      display->setCursor(0, 0);  display->printf( "      avg  min  max");
+      display->setCursor(0, 10);  display->printf("dB(A) %.1f %.1f %.1f", la.avg, la.min, la.max), 
+      display->setCursor(0, 20);  display->printf("dB(C) %.1f %.1f %.1f", lc.avg, lc.min, lc.max);
+      display->setCursor(0, 30);  display->printf("dB(Z) %.1f %.1f %.1f", lz.avg, lz.min, lz.max);
+    }
+  }
+  if( _leq != NULL && _leq->leq( 0) > 0.0) {
+    // LAeq over 1, 5, 15 and 60 min.
+    display->setCursor(0, 40);  display->printf("LAeq %.0f %.0f %.0f %.0f", _leq->leq( 0), _leq->leq( 1), _leq->leq( 2), _leq->leq( 3));
+  }
+  else {
+    display->setCursor(0, 40);  display->print( deveui);
   }
-  display->setCursor(0, 40);  display->print( deveui);
   display->setCursor(0, 50);  display->print( status);
   display->display();
 }
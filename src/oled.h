@@ -12,20 +12,23 @@
 #include <Adafruit_SSD1306.h>
 #include <Adafruit_SSD1306.h>
 #include "measurement.h"
+#include "rollingleq.h"
 
 class Oled {
   public:
     Oled();
     ~Oled();
     void begin(); 
-    void values( Measurement* la, Measurement* lc, Measurement* lz);
+    void values( WeightingCurve* la, WeightingCurve* lc, WeightingCurve* lz);
+    void rolling( RollingLeq* leq);
     void update();
 
     const char* status;
     const char* deveui;
 
   private:
-    Measurement *_la, *_lc, *_lz;
+    WeightingCurve *_la, *_lc, *_lz;
+    RollingLeq *_leq;
     Adafruit_SSD1306 *display;
 }; 
 
@@ -0,0 +1,138 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file profile.h
+ * \brief Time of the DSP stages in CPU cycles, per report interval.
+ *
+ * With DSP_PROFILE defined the stages of each frame are timed with the cycle
+ * counter of the core, one counter read per stage boundary. A stage keeps the
+ * count, min, sum and max of a report interval, and a histogram of its time in
+ * tenths of the frame time. The frame time is the budget of the audio core: a
+ * frame that takes longer delays the next one, the capture catches up for a
+ * while but in the end the DMA buffers overrun.
+ *
+ * Without DSP_PROFILE the macros are empty, nothing is compiled in.
+ */
+
+#ifndef __PROFILE_H_
+#define __PROFILE_H_
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "config.h"
+
+#define PROFILE_BUCKETS 10          ///< histogram buckets of a tenth of the frame time, one more for longer
+
+/// \brief stages of the audio core
+enum ProfileStage {
+  PROFILE_READ,                     ///< capture task blocked in i2s_read(), waiting for the DMA
+  PROFILE_CONVERT,                  ///< DC removal, scaling and window, one pass
+  PROFILE_TRANSFORM,                ///< FFT, or the filters
+  PROFILE_BANDS,                    ///< energy of the bins summed up in the bands
+  PROFILE_FRAME,                    ///< all DSP of a frame, from the block to the band energies
+  PROFILE_STAGES
+};
+
+static const char *const PROFILE_NAMES[PROFILE_STAGES] = { "read", "convert", "transform", "bands", "frame" };
+
+/// \brief cycles of one stage in a report interval
+class ProfileStats {
+  public:
+    ProfileStats() {
+      budget( PROFILE_BUCKETS);
+      reset();
+    }
+
+    /// \brief time of a frame in cycles, the histogram is in tenths of it
+    void budget( uint32_t cycles) {
+      _budget = cycles;
+      _step = cycles / PROFILE_BUCKETS;
+      if( _step == 0)
+        _step = 1;
+    }
+
+    void reset() {
+      _count = 0;
+      _min = UINT32_MAX;
+      _max = 0;
+      _sum = 0;
+      for( int i = 0; i <= PROFILE_BUCKETS; i++)
+        _histogram[i] = 0;
+    }
+
+    inline void add( uint32_t cycles) {
+      _count++;
+      _sum += cycles;
+      if( cycles < _min)
+        _min = cycles;
+      if( cycles > _max)
+        _max = cycles;
+      uint32_t bucket = cycles / _step;
+      _histogram[ (bucket < PROFILE_BUCKETS) ? bucket : PROFILE_BUCKETS]++;
+    }
+
+    uint32_t count() const { return _count; }
+    uint32_t min() const { return (_count > 0) ? _min : 0; }
+    uint32_t max() const { return _max; }
+    uint32_t mean() const { return (_count > 0) ? (uint32_t)(_sum / _count) : 0; }
+
+    /// \brief sum of the stage relative to the frame time of all frames, the duty cycle
+    float duty() const { return (_count > 0) ? (float)_sum / ((float)_budget * _count) : 0.0; }
+
+    /// \brief part of the frame time left after the longest frame
+    float headroom() const { return 1.0 - (float)_max / _budget; }
+
+    /// \brief print one line, times in us
+    /// \param [in] mhz cycles per us
+    void print( const char *name, uint32_t mhz) const {
+      printf("  %-11s n=%-4u min=%-6u mean=%-6u max=%-6u us |", name, _count, min() / mhz, mean() / mhz, _max / mhz);
+      for( int i = 0; i <= PROFILE_BUCKETS; i++)
+        printf(" %u", _histogram[i]);
+      printf("\n");
+    }
+
+  private:
+    uint32_t _count;
+    uint32_t _min, _max;
+    uint64_t _sum;
+    uint32_t _budget;                 ///< frame time in cycles
+    uint32_t _step;                   ///< cycles per bucket
+    uint16_t _histogram[PROFILE_BUCKETS + 1];  ///< frames per tenth of the frame time, the last one longer
+};
+
+/// \brief profile of the audio core in a report interval, for the diagnostics uplink
+struct ProfileSummary {
+  uint32_t mean[PROFILE_STAGES];    ///< in us
+  uint32_t max[PROFILE_STAGES];     ///< in us
+  float    duty;                    ///< DSP time relative to the frame time
+  float    headroom;                ///< part of the frame time left after the longest frame
+  uint32_t overruns;                ///< DMA buffers dropped since the start
+};
+
+#ifdef DSP_PROFILE
+/// \brief cycle counter of the core, wraps after 17.9 s at 240 MHz, only differences count
+static inline uint32_t profileCycles() { return ESP.getCycleCount(); }
+
+#define PROFILE_START(t)      uint32_t t = profileCycles()
+// add the cycles since t to the stats, and start the next stage at t
+#define PROFILE_LAP(stats, t) do { uint32_t now_ = profileCycles(); (stats).add( now_ - (t)); (t) = now_; } while( 0)
+#define PROFILE_STOP(stats, t) (stats).add( profileCycles() - (t))
+#else
+#define PROFILE_START(t)
+#define PROFILE_LAP(stats, t)
+#define PROFILE_STOP(stats, t)
+#endif
+
+#endif // __PROFILE_H_
@@ -0,0 +1,124 @@
+/*--------------------------------------------------------------------
+  This file is part of the TTN-Apeldoorn Sound Sensor.
+
+  This code is free software:
+  you can redistribute it and/or modify it under the terms of a Creative
+  Commons Attribution-NonCommercial 4.0 International License
+  (http://creativecommons.org/licenses/by-nc/4.0/) by
+  TTN-Apeldoorn (https://www.thethingsnetwork.org/community/apeldoorn/)
+
+  The program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+  --------------------------------------------------------------------*/
+
+/*!
+ * \file rollingleq.h
+ * \brief Equivalent sound levels over the last 1, 5, 15 and 60 minutes.
+ *
+ * The frames are averaged per second and the mean energy of each second
+ * is kept in a ring of one hour. Each window has a running sum: the new
+ * second is added and the second that leaves the window is subtracted,
+ * so an update and a query do not depend on the window length.
+ * Seconds without frames (sound measurement stopped) are kept as missing
+ * and do not count, so Leq is the average over the measured seconds.
+ * The seconds are counted from the first frame, with millis() time that
+ * may wrap around.
+ */
+
+#ifndef __ROLLING_LEQ_H_
+#define __ROLLING_LEQ_H_
+
+#include <stdint.h>
+#include <math.h>
+
+#define ROLLING_SECONDS 3600        ///< length of the ring, the longest window
+#define ROLLING_WINDOWS 4           ///< 1, 5, 15 and 60 minutes
+
+class RollingLeq {
+  public:
+    RollingLeq() {
+      for (int i = 0; i < ROLLING_SECONDS; i++)
+        _ring[i] = -1.0;
+      for (int w = 0; w < ROLLING_WINDOWS; w++) {
+        _sum[w] = 0.0;
+        _count[w] = 0;
+      }
+      _head = 0;
+      _time = 0;
+      _started = false;
+      _energy = 0.0;
+      _frames = 0;
+    }
+
+    /// \brief add the energy of one frame
+    /// \param [in] energy weighted energy of the frame
+    /// \param [in] ms time of the frame in ms, millis(), a frame older than the current second is counted in it
+    void add(float energy, uint32_t ms) {
+      if (!_started) {
+        _time = ms;
+        _started = true;
+      }
+      advance(ms);
+      _energy += energy;
+      _frames++;
+    }
+
+    /// \brief close the seconds before ms, also when there are no frames
+    /// \param [in] ms time in ms, millis()
+    void advance(uint32_t ms) {
+      int32_t elapsed = (int32_t)(ms - _time);      // since the start of the current second
+      if (!_started || elapsed < 1000)
+        return;
+      push((_frames > 0) ? _energy / _frames : -1.0);
+      uint32_t seconds = elapsed / 1000;
+      for (uint32_t i = 1; i < seconds && i <= ROLLING_SECONDS; i++)
+        push(-1.0);                                 // seconds without frames
+      _time += seconds * 1000;
+      _energy = 0.0;
+      _frames = 0;
+    }
+
+    /// \brief equivalent level of a window in dB, 0.0 when there is no measured second in it
+    /// \param [in] window 0 .. ROLLING_WINDOWS-1 for 1, 5, 15 and 60 minutes
+    float leq(int window) const {
+      if (_count[window] == 0 || _sum[window] <= 0.0)
+        return 0.0;
+      return 10.0 * log10(_sum[window] / _count[window]);
+    }
+
+    /// \brief length of a window in seconds
+    static uint16_t seconds(int window) {
+      static const uint16_t lengths[ROLLING_WINDOWS] = { 60, 300, 900, 3600 };
+      return lengths[window];
+    }
+
+  private:
+    float    _ring[ROLLING_SECONDS];     ///< mean energy per second, < 0.0 for a missing second
+    uint16_t _head;                      ///< slot of the next second
+    double   _sum[ROLLING_WINDOWS];      ///< running sum per window, double so the subtractions do not drift
+    uint16_t _count[ROLLING_WINDOWS];    ///< measured seconds per window
+    uint32_t _time;                      ///< start of the current second in ms
+    bool     _started;                   ///< _time is set by the first frame
+    float    _energy;                    ///< sum of the frames in this second
+    uint16_t _frames;                    ///< frames in this second
+
+    // append a second, and remove the second that leaves each window
+    void push(float energy) {
+      for (int w = 0; w < ROLLING_WINDOWS; w++) {
+        float leaving = _ring[(_head + ROLLING_SECONDS - seconds(w)) % ROLLING_SECONDS];
+        if (leaving >= 0.0) {
+          _sum[w] -= leaving;
+          _count[w]--;
+        }
+        if (energy >= 0.0) {
+          _sum[w] += energy;
+          _count[w]++;
+        }
+      }
+      _ring[_head] = energy;
+      _head = (_head + 1) % ROLLING_SECONDS;
+    }
+};
+
+#endif // __ROLLING_LEQ_H_
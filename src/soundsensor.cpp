@@ -30,8 +30,8 @@ const i2s_config_t i2s_config = {
   .channel_format       = I2S_CHANNEL_FMT_ONLY_LEFT,                 // For ARduino V2.2 changed From LEFT to RIGHT !!!!!! 
   .communication_format = i2s_comm_format_t(I2S_COMM_FORMAT_I2S | I2S_COMM_FORMAT_I2S_MSB),
   .intr_alloc_flags     = ESP_INTR_FLAG_LEVEL1,                       // Interrupt level 1
-  .dma_buf_count        = 8,                                          // number of buffers
-  .dma_buf_len          = 1024,                                       //BLOCK_SIZE, samples per buffer
+  .dma_buf_count        = DMA_BUF_COUNT,                              // number of buffers
+  .dma_buf_len          = DMA_BUF_LEN,                                //BLOCK_SIZE, samples per buffer
   .use_apll             = true
 };
 
@@ -57,24 +57,71 @@ const i2s_pin_config_t pin_config = {
   #error Unsupported board selection.
 #endif
 
+#if defined(IIR_FILTERS)
+SoundSensor::SoundSensor() : _octaves( SAMPLE_FREQ) {
+  designAWeighting( _aWeighting, SAMPLE_FREQ);
+  designCWeighting( _cWeighting, SAMPLE_FREQ);
+#else
 SoundSensor::SoundSensor() {
-  _fft = new arduinoFFT(_real, _imag, SAMPLES, SAMPLES);
+  // HANN window, optimal for energy calculations, applied by the front end
+  arduinoFFT window(NULL, NULL, SAMPLES, SAMPLES);
+  const float *w = window.WindowTable(FFT_WIN_TYP_HANN);
+  for (int i = 0; i < SAMPLES / 2; i++) {
+#ifdef FIXED_POINT_DSP
+    _window[i] = (int32_t)lround(w[i] * (1L << 30));   // Q30, the weighing factor can be slightly above 1.0
+#else
+    _window[i] = w[i];
+#endif
+  }
+#endif
+#ifdef THIRD_OCTAVES
+  // third octaves 25 Hz .. 10 kHz, edge bins weighted by their overlap
+  _bands.thirdOctaves( (float)SAMPLE_FREQ / SAMPLES, SAMPLES / 2 - 1);
+#else
+  // whole octaves 31.5 Hz .. 8 kHz, or 16 kHz wide band, skip the bins below 22 Hz
+  _bands.octaves(OCTAVE_FIRST_BIN, OCTAVES);
+#endif
   _runningDC = 0.0;
   _runningN = 0;
   offset( 0.0);
+  _last = NO_SLOT;
+  _primed = false;
+  _busy = 0;
+  _frames = 0;
+  _busyMax = 0;
+  _latencySum = 0;
+  _latencyMax = 0;
+#ifdef RAW_CAPTURE
+  _streamed = 0;
+  _restart = false;
+#endif
+  _captureTask = NULL;
+  _events = NULL;
+  _full = NULL;
+  _free = NULL;
+  _blocks = 0;
+  _overruns = 0;
+  _dmaErrors = 0;
+  _resync = true;
+  _dmaDone = 0;
+  _samplesRead = 0;
   _i2s = false;
+#ifdef DSP_PROFILE
+  memset( _summaries, 0, sizeof( _summaries));
+  _summarySeq = 0;
+#endif
 }
 
 SoundSensor::~SoundSensor(){
   i2s_driver_uninstall(  I2S_PORT);
-  delete _fft;
 }
 
 void SoundSensor::begin(){
   
   // Configuring the I2S driver and pins.
   // This function must be called before any I2S driver read/write operations.
-  _err = i2s_driver_install(I2S_PORT, &i2s_config, 0, NULL);
+  // with an event queue, the DMA buffers that are filled are counted to detect overruns
+  _err = i2s_driver_install(I2S_PORT, &i2s_config, EVENT_QUEUE_LEN, &_events);
  // printf("_err=%d\n", _err);
 //  printf("%d, %d, %d, %d\n", pin_config.bck_io_num, pin_config.ws_io_num, pin_config.data_out_num, pin_config.data_in_num);
   if (_err != ESP_OK) {
@@ -89,11 +136,34 @@ void SoundSensor::begin(){
   }
   printf("I2S driver installed.\n");
   stop(); 
+#ifdef DSP_PROFILE
+  // the histograms are in tenths of the frame time, in cycles of the CPU clock
+  uint32_t budget = (uint64_t)BLOCK_SIZE * ESP.getCpuFreqMHz() * 1000000 / SAMPLE_FREQ;
+  for (int i = 0; i < PROFILE_STAGES; i++)
+    _profile[i].budget( budget);
+#endif
+
+  // the capture task reads the blocks in the slots of the ring, and hands them off to the DSP
+  _full = xQueueCreate( CAPTURE_SLOTS, sizeof( CaptureBlock));
+  _free = xSemaphoreCreateCounting( CAPTURE_SLOTS, CAPTURE_SLOTS);
+  xTaskCreatePinnedToCore(
+                    captureTask, // Task function.
+                    "Capture",   // name of task.
+                    4096,        // Stack size of task
+                    this,        // parameter of the task
+                    2,           // priority above the DSP, so DMA buffers are emptied in time
+                    &_captureTask, // Task handle
+                    0);          // the audio core
 }
 
 void SoundSensor::start() {
   printf("i2s_start\n");
   i2s_start( I2S_PORT);
+  _resync = true;     // the driver may have dropped buffers while stopped
+  _primed = false;    // samples in the ring are from before the stop
+#ifdef RAW_CAPTURE
+  _restart = true;    // a replay of the capture primes the window at the same block
+#endif
   _i2s = true;
 }
 
@@ -106,12 +176,185 @@ void SoundSensor::stop() {
 
 float* SoundSensor::readSamples(){
   // Read multiple samples at once and calculate the sound pressure
-   
+  CaptureBlock block;
+#ifdef OVERLAP_FRAMES
+  // the window is the previous half block followed by the new one, both stay in their slot
+  // the slot of the previous half block is kept until the next frame, nothing is copied
+  if( !_primed) {
+    if( _last != NO_SLOT)
+      xSemaphoreGive( _free);   // half block from before a stop
+    receiveBlock( block);
+    _last = block.slot;
+    _primed = true;
+  }
+  receiveBlock( block);
+  int32_t *older = slot( _last);
+  int32_t *newer = slot( block.slot);
+#else
+  receiveBlock( block);
+  int32_t *older = slot( block.slot);
+  int32_t *newer = older + SAMPLES / 2;
+#endif
+  uint32_t start = micros();
+  uint32_t latency = start - block.time;
+  _latencySum += latency;
+  if( latency > _latencyMax)
+    _latencyMax = latency;
+
+  process( older, newer);
+
+  uint32_t busy = micros() - start;
+  _busy += busy;
+  if( busy > _busyMax)
+    _busyMax = busy;
+  _frames++;
+
+  // done with the slot, the capture task can fill it again
+  // with overlap this is the older half, the new half is kept for the next frame
+  xSemaphoreGive( _free);
+#ifdef OVERLAP_FRAMES
+  _last = block.slot;
+#endif
+  return _energy;
+}
+
+float* SoundSensor::process(int32_t *older, int32_t *newer) {
+  PROFILE_START( frame);
+  PROFILE_START( lap);
+#ifdef OVERLAP_FRAMES
+  int32_t *samples = newer;     // the new half block
+#else
+  int32_t *samples = older;     // the whole block
+#endif
+#if defined(IIR_FILTERS)
+  // the filters run on over the blocks, so only the new block is filtered, there are no gaps
+  // the priming half block of an overlapped window is left out
+  (void)older;
+  (void)newer;
+  integerToLevel( samples, _real, BLOCK_SIZE);
+  PROFILE_LAP( _profile[PROFILE_CONVERT], lap);
+
+  // A and C weighted energy
+  _weighted[0] = _aWeighting.energy( _real, BLOCK_SIZE) * (IIR_ENERGY_SCALE / BLOCK_SIZE);
+  _weighted[1] = _cWeighting.energy( _real, BLOCK_SIZE) * (IIR_ENERGY_SCALE / BLOCK_SIZE);
+
+  // octave energies, _real is used for the decimated signal
+  _octaves.process( _real, BLOCK_SIZE, _energy);
+  PROFILE_LAP( _profile[PROFILE_TRANSFORM], lap);
+  for (int i = 0; i < BANDS; i++)
+    _energy[i] *= IIR_ENERGY_SCALE;
+  PROFILE_LAP( _profile[PROFILE_BANDS], lap);
+#elif defined(FIXED_POINT_DSP)
+#ifdef OVERLAP_FRAMES
+  (void)samples;
+  int32_t *spectrum = _fixed;
+#else
+  int32_t *spectrum = samples;             // in place, the samples are not needed anymore
+#endif
+  // remove DC, apply HANN window and convert to Q31, in one pass
+  integerToFixed(older, newer, spectrum, SAMPLES);
+  PROFILE_LAP( _profile[PROFILE_CONVERT], lap);
+
+  // do FFT processing in integer math
+  int8_t exponent = _transform.forward(spectrum);
+  PROFILE_LAP( _profile[PROFILE_TRANSFORM], lap);
+
+  // sum up energy in bin for each band
+  sumEnergyFixed(spectrum, exponent, _bands, _energy);
+  PROFILE_LAP( _profile[PROFILE_BANDS], lap);
+#else
+  (void)samples;
+  // remove DC, scale and apply HANN window, in one pass
+  integerToFloat(older, newer, _real, SAMPLES);
+  PROFILE_LAP( _profile[PROFILE_CONVERT], lap);
+
+  // do FFT processing, real input gives SAMPLES/2+1 unique bins
+  _transform.forward(_real);
+  PROFILE_LAP( _profile[PROFILE_TRANSFORM], lap);
+
+  // calculate energy in each bin and sum it up for each band
+  sumEnergy(_real, _bands, _energy);
+  PROFILE_LAP( _profile[PROFILE_BANDS], lap);
+#endif
+  PROFILE_STOP( _profile[PROFILE_FRAME], frame);
+  return _energy;
+}
+
+void SoundSensor::receiveBlock(CaptureBlock &block) {
+  xQueueReceive( _full, &block, portMAX_DELAY);
+#ifdef RAW_CAPTURE
+  stream( slot( block.slot));
+#endif
+}
+
+#ifdef RAW_CAPTURE
+// the whole frame in one write, Serial holds its lock for it, so log lines written through
+// Serial stay between the frames
+// at CAPTURE_BAUD the write takes about 3/4 of the frame time, the DSP time is not included in it
+void SoundSensor::stream(const int32_t *samples) {
+  captureEncode( _frame, _streamed++, SAMPLE_FREQ, _overruns, _restart ? CAPTURE_RESTART : 0, samples, BLOCK_SIZE);
+  _restart = false;
+  Serial.write( _frame, sizeof( _frame));
+}
+#endif
+
+void SoundSensor::captureTask(void *parameter) {
+  ((SoundSensor *)parameter)->capture();
+}
+
+// fill the slots of the ring in turn, a slot is filled when the DSP has released it
+// while waiting, the I2S events are counted so no DMA buffer is missed
+void SoundSensor::capture() {
+  const TickType_t bufferTime = pdMS_TO_TICKS( DMA_BUF_LEN * 1000 / SAMPLE_FREQ);
+  uint8_t index = 0;
+  while( true) {
+    while( xSemaphoreTake( _free, bufferTime) != pdTRUE)
+      countEvents();
+    PROFILE_START( read);
+    readBlock( slot( index), BLOCK_SIZE);
+#ifdef DSP_PROFILE
+    portENTER_CRITICAL( &_readLock);
+    PROFILE_STOP( _profile[PROFILE_READ], read);
+    portEXIT_CRITICAL( &_readLock);
+#endif
+    CaptureBlock block = { index, micros() };
+    _samplesRead += BLOCK_SIZE;
+    _blocks++;
+    countEvents();
+    xQueueSend( _full, &block, portMAX_DELAY);   // never waits, the queue has room for all slots
+    index = (index + 1) % CAPTURE_SLOTS;
+  }
+}
+
+// count the DMA buffers filled by the driver, each gives an RX_DONE event
+// the driver keeps DMA_BUF_COUNT buffers at most and drops the oldest when the capture is too late,
+// so more buffers filled than read and kept is an overrun
+void SoundSensor::countEvents() {
+  i2s_event_t event;
+  while( xQueueReceive( _events, &event, 0) == pdTRUE) {
+    if( event.type == I2S_EVENT_RX_DONE)
+      _dmaDone++;
+    else if( event.type == I2S_EVENT_DMA_ERROR)
+      _dmaErrors++;
+  }
+  if( _resync) {
+    _resync = false;
+    _samplesRead = _dmaDone * DMA_BUF_LEN;
+  }
+  int32_t pending = (int32_t)(_dmaDone * DMA_BUF_LEN - _samplesRead);   // modulo 2^32, so it survives a wrap
+  if( pending > DMA_BUF_COUNT * DMA_BUF_LEN) {
+    uint32_t dropped = (pending - DMA_BUF_COUNT * DMA_BUF_LEN + DMA_BUF_LEN - 1) / DMA_BUF_LEN;
+    _overruns += dropped;
+    _samplesRead += dropped * DMA_BUF_LEN;
+  }
+}
+
+void SoundSensor::readBlock(int32_t *samples, int count) {
   size_t num_bytes_read;
   _err = i2s_read(
     I2S_PORT,
-    (char *) _samples,
-    BLOCK_SIZE * 4,        // 4 bytes per sample
+    (char *) samples,
+    count * 4,             // 4 bytes per sample
     &num_bytes_read,
     portMAX_DELAY
   );    // no timeout
@@ -119,22 +362,75 @@ float* SoundSensor::readSamples(){
    if(_err != ESP_OK){
     printf("%d err\n",_err);
   }
- 
-  integerToFloat(_samples, _real, _imag, SAMPLES);
+}
 
-  // apply HANN window, optimal for energy calculations
-  _fft->Windowing(FFT_WIN_TYP_HANN, FFT_FORWARD);     // changed was FFT_WIN_TYP_FLT_TOP
- 
-  // do FFT processing
-  _fft->Compute(FFT_FORWARD);
+void SoundSensor::report() {
+  uint32_t latencyAvg = (_frames > 0) ? _latencySum / _frames : 0;
+  uint32_t frames = _frames;
+  float headroom = 1.0 - _busyMax / (BLOCK_SIZE * 1000000.0 / SAMPLE_FREQ);
+  printf("audio frames=%u DSP load=%.1f%% headroom=%.1f%% blocks=%u overruns=%u DMA errors=%u latency avg=%u max=%u us\n",
+    frames, 100.0 * load(), 100.0 * headroom, _blocks, _overruns, _dmaErrors, latencyAvg, _latencyMax);
+  _busyMax = 0;
+  _latencySum = 0;
+  _latencyMax = 0;
+#ifdef DSP_PROFILE
+  // stages in cycles, published for the diagnostics uplink of the other core
+  // the read stage is added by the capture task, which preempts this one, it is taken and reset in one go
+  ProfileStats stats[PROFILE_STAGES];
+  portENTER_CRITICAL( &_readLock);
+  stats[PROFILE_READ] = _profile[PROFILE_READ];
+  _profile[PROFILE_READ].reset();
+  portEXIT_CRITICAL( &_readLock);
+  for (int i = 0; i < PROFILE_STAGES; i++) {
+    if( i != PROFILE_READ) {
+      stats[i] = _profile[i];
+      _profile[i].reset();
+    }
+  }
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  const ProfileStats &frame = stats[PROFILE_FRAME];
+  printf("DSP profile at %u MHz, frame time %.1f ms, duty=%.1f%% headroom=%.1f%%, histogram in tenths of the frame time\n",
+    mhz, BLOCK_SIZE * 1000.0 / SAMPLE_FREQ, 100.0 * frame.duty(), 100.0 * frame.headroom());
+  for (int i = 0; i < PROFILE_STAGES; i++)
+    stats[i].print( PROFILE_NAMES[i], mhz);
 
-  // calculate energy in each bin
-  calculateEnergy(_real, _imag, SAMPLES);
+  uint32_t seq = _summarySeq.load( std::memory_order_relaxed);   // even, twice the number of published profiles
+  _summarySeq.store( seq + 1, std::memory_order_relaxed);         // odd while the next profile is written
+  std::atomic_thread_fence( std::memory_order_release);
+  ProfileSummary& s = _summaries[ ((seq >> 1) + 1) & 1];        // not the buffer of the last profile
+  for (int i = 0; i < PROFILE_STAGES; i++) {
+    s.mean[i] = stats[i].mean() / mhz;
+    s.max[i] = stats[i].max() / mhz;
+  }
+  s.duty = frame.duty();
+  s.headroom = frame.headroom();
+  s.overruns = _overruns;
+  _summarySeq.store( seq + 2, std::memory_order_release);         // publish
+#endif
+}
 
-  // sum up energy in bin for each octave
-  sumEnergy(_real, _energy);
+#ifdef DSP_PROFILE
+// copy the last profile, the same seqlock as Measurement::result(), its buffer is written again
+// from the start of the publish after the next one on
+ProfileSummary SoundSensor::profile() const {
+  ProfileSummary s;
+  uint32_t seq;
+  do {
+    seq = _summarySeq.load( std::memory_order_acquire);
+    s = _summaries[ (seq >> 1) & 1];
+    std::atomic_thread_fence( std::memory_order_acquire);
+  } while( _summarySeq.load( std::memory_order_relaxed) - (seq & ~1u) > 2);
+  return s;
+}
+#endif
 
-  return _energy;
+// DSP time relative to the audio time of the frames, a new frame every BLOCK_SIZE samples
+float SoundSensor::load() {
+  float audio = _frames * (BLOCK_SIZE * 1000000.0 / SAMPLE_FREQ);   // in us
+  float load = (_frames > 0) ? _busy / audio : 0.0;
+  _busy = 0;
+  _frames = 0;
+  return load;
 }
 
 // convert WAV integers to float
@@ -153,65 +449,141 @@ float* SoundSensor::readSamples(){
   //printf("DC offset %d\n", offset);
 }*/
 
-void SoundSensor::integerToFloat(int32_t * samples, float *vReal, float *vImag, uint16_t size) {
-  float sum = 0.0;
-  // calculate offset
-   for (uint16_t i = 0; i < size; i++) {
-    int32_t val = (samples[i] >> 8);            // move 24 value bits on the correct place in a long
-    vReal[i] = (float)val;
-    sum += vReal[i];
+#if !defined(IIR_FILTERS)
+// front end in one pass over the DMA buffer, written straight into the FFT input
+// the DC offset is the running estimate of the previous blocks, the mean of this block is
+// accumulated in the same pass and applied to the next block
+// the window is symmetric, so sample i and size-1-i share one weighing factor,
+// sample i is in the older half and sample size-1-i in the newer half of the window
+void SoundSensor::integerToFloat(const int32_t *older, const int32_t *newer, float *vReal, uint16_t size) {
+  const uint16_t half = size >> 1;
+  if( _runningN == 0)
+    updateDC( (blockMean( older, half) + blockMean( newer, half)) / 2);  // no estimate yet, use this block
+  float dc = _runningDC;
+  float gain = _gain;
+  int64_t sum = 0;
+  for (uint16_t i = 0; i < half; i++) {
+    uint16_t j = size - 1 - i;
+    int32_t a = (older[i] >> 8);                // move 24 value bits on the correct place in a long
+    int32_t b = (newer[half - 1 - i] >> 8);
+    sum += a + b;
+    float weight = gain * _window[i];
+    vReal[i] = ((float)a - dc) * weight;
+    vReal[j] = ((float)b - dc) * weight;
   }
-  float offs = sum / (float)size;   //dc component
+  updateDC( (float)sum / (float)size);
+}
+#else
+// convert WAV integers to float for the filters, with the same DC compensation as integerToFloat
+void SoundSensor::integerToLevel(const int32_t *samples, float *v, uint16_t size) {
+  if( _runningN == 0)
+    updateDC( blockMean( samples, size));      // no estimate yet, use this block
+  float dc = _runningDC;
+  float gain = _gain;
+  int64_t sum = 0;
+  for (uint16_t i = 0; i < size; i++) {
+    int32_t a = (samples[i] >> 8);
+    sum += a;
+    v[i] = ((float)a - dc) * gain;
+  }
+  updateDC( (float)sum / (float)size);
+}
+#endif
+
+// mean of the 24 bit values of one block
+float SoundSensor::blockMean(const int32_t *samples, uint16_t size) {
+  int64_t sum = 0;
+  for (uint16_t i = 0; i < size; i++)
+    sum += (samples[i] >> 8);
+  return (float)sum / (float)size;
+}
+
+// update the running DC estimate (moving average over the last 100 blocks) with the mean of a block
+void SoundSensor::updateDC(float mean) {
   if( _runningN < 100)
     _runningN++;
-  float newDC = _runningDC + (offs - _runningDC)/_runningN;
-  _runningDC = newDC;
+  _runningDC = _runningDC + (mean - _runningDC)/_runningN;
+  if( fabsf( _runningDC) < 1e-20f)
+    _runningDC = 0.0;                           // digital silence decays it into the denormals, and it is subtracted from every sample
+}
 
-  for (uint16_t i = 0; i < size; i++) {
-    vReal[i] = (vReal[i] - newDC) / (256.0 * FACTOR / _factor);   // 30.0 adjustment
-    vImag[i] = 0.0;
+#ifdef FIXED_POINT_DSP
+// convert WAV integers to Q31, in one pass
+// the same DC compensation as integerToFloat, followed by the HANN window in Q30
+// the mic. correction is applied to the energies, so no float math is done per sample
+// vFixed may be the buffer of the samples, each pair is read before it is written
+void SoundSensor::integerToFixed(const int32_t *older, const int32_t *newer, int32_t *vFixed, uint16_t size) {
+  const uint16_t half = size >> 1;
+  if( _runningN == 0)
+    updateDC( (blockMean( older, half) + blockMean( newer, half)) / 2);  // no estimate yet, use this block
+  int32_t dc = lroundf(_runningDC);
+  int64_t sum = 0;
+  for (uint16_t i = 0; i < half; i++) {
+    uint16_t j = size - 1 - i;
+    int32_t a = (older[i] >> 8);
+    int32_t b = (newer[half - 1 - i] >> 8);
+    sum += a + b;
+    vFixed[i] = (int32_t)(((int64_t)((a - dc) * (1 << FIXED_PRESHIFT)) * _window[i]) >> 30);   // no left shift of a negative value
+    vFixed[j] = (int32_t)(((int64_t)((b - dc) * (1 << FIXED_PRESHIFT)) * _window[i]) >> 30);
   }
-  //printf("DC offset %f\n", newDC);
+  updateDC( (float)sum / (float)size);
 }
 
-// calculates energy from Re and Im parts and places it back in the Re part (Im part is zeroed)
-void SoundSensor::calculateEnergy(float *vReal, float *vImag, uint16_t samples)
-{
-  for (uint16_t i = 0; i < samples; i++) {
-    vReal[i] = sq(vReal[i]) + sq(vImag[i]);
-    vImag[i] = 0.0;
+// energy of one bin of the packed fixed point spectrum, scaled down by 2^(2*es)
+static inline uint64_t binEnergyFixed(const int32_t *spectrum, int bin, uint8_t es) {
+  int32_t re = spectrum[2 * bin] >> es;
+  int32_t im = spectrum[2 * bin + 1] >> es;
+  return (int64_t)re * re + (int64_t)im * im;
+}
+
+// sums up energy of the packed fixed point spectrum in the bands of the map
+// the values are scaled down so 64 bit accumulators cannot overflow, energy = sum * 2^(2*scale) * gain^2
+void SoundSensor::sumEnergyFixed(const int32_t *spectrum, int8_t exponent, const BandMap &map, float *energies) {
+  uint8_t es = 0;
+  while ((_transform.peak() >> es) >= (1UL << 25))
+    es++;
+  int scale = 2 * (es + exponent - FIXED_PRESHIFT);
+
+  for (int band = 0; band < map.bands; band++){
+    int first = map.first[band];
+    int last = map.last[band];
+    uint64_t sum = 0;
+    for (int bin = first; bin <= last; bin++){
+      int32_t re = spectrum[2 * bin] >> es;
+      int32_t im = spectrum[2 * bin + 1] >> es;
+      sum += (int64_t)re * re + (int64_t)im * im;
+    }
+    float energy = (float)sum;
+    // leave out the part of the edge bins outside the band
+    if (map.lowCut[band] > 0.0 || map.highCut[band] > 0.0) {
+      energy -= map.lowCut[band] * (float)binEnergyFixed(spectrum, first, es);
+      energy -= map.highCut[band] * (float)binEnergyFixed(spectrum, last, es);
+    }
+    energies[band] = ldexpf(energy, scale) * _gain * _gain;
   }
 }
+#endif
 
 // convert dB offset to factor
 void SoundSensor::offset( float dB) {
-   _factor = pow(10, dB / 20.0);    // convert dB to factor 
+   float factor = pow(10, dB / 20.0);    // convert dB to factor 
+   _gain = factor / (256.0 * FACTOR);    // 30.0 adjustment
+   _gain *= (float)CALIBRATION_SAMPLES / SAMPLES;   // the same levels with a larger FFT
 }
 
-// sums up energy in whole octave bins
-void SoundSensor::sumEnergy(const float *samples, float *energies) {
-
-  // skip the first two bins
-  int bin_size = 2;
-  int bin = bin_size;
-  for (int octave = 0; octave < OCTAVES; octave++){
+// calculates energy from the packed Re and Im parts and sums it up in the bands of the map
+// only the bins of the bands are touched, bin k is at spectrum[2k], spectrum[2k+1] (0 < k < SAMPLES/2)
+void SoundSensor::sumEnergy(const float *spectrum, const BandMap &map, float *energies) {
+  for (int band = 0; band < map.bands; band++){
+    int first = map.first[band];
+    int last = map.last[band];
     float sum = 0.0;
-    for (int i = 0; i < bin_size; i++){
-      sum += samples[bin++];
+    for (int bin = first; bin <= last; bin++){
+      sum += sq(spectrum[2 * bin]) + sq(spectrum[2 * bin + 1]);
     }
-    energies[octave] = sum;
-    bin_size *= 2;
-    //printf("octaaf=%d, bin=%d, sum=%f\n", octave, bin-1, sum);
-  }
-}
-
-/*
-// generate test sinus
-static void generateSineWave( int32_t* samples, float amplitude, float freq) {
-  float c = round( freq / (SAMPLE_FREQ / (float)SAMPLES)) / SAMPLES;     // put a multipe of complete sinewaves in buffer
-  for ( int i = 0; i < BLOCK_SIZE; i++) {
-    int32_t temp = 256 * amplitude * sin((float)i * c * twoPi );        // sine wave
-    samples[i] = temp & 0xFFFFFF00;  // convert to WAV integers
+    // leave out the part of the edge bins outside the band
+    sum -= map.lowCut[band] * (sq(spectrum[2 * first]) + sq(spectrum[2 * first + 1]));
+    sum -= map.highCut[band] * (sq(spectrum[2 * last]) + sq(spectrum[2 * last + 1]));
+    energies[band] = sum;
   }
 }
-*/
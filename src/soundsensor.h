@@ -21,17 +21,76 @@
 #define __SOUND_SENSOR_H_
 
 #include <Arduino.h>
+#include <atomic>
 #include <driver/i2s.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include "config.h"
 #include "arduinoFFT.h"
+#include "fft.h"
+#include "fixedfft.h"
+#include "iirfilters.h"
+#include "bands.h"
+#include "profile.h"
+#ifdef RAW_CAPTURE
+#include "capture.h"
+#endif
 
 #define FACTOR 30.0        /// \todo to be cheked why this 10.0 ?
 
 // size of noise sample
-#define SAMPLES 2048  //1024       ///< at sample frequency of 22,627 kHz with 2048 samples, duration is 90 ms.
+#ifdef WIDE_BAND
+#define SAMPLES 4096               ///< at sample frequency of 45,254 kHz with 4096 samples, duration is 90 ms.
+#define SAMPLE_FREQ 45254          ///< up to 22.6 kHz for the 16 kHz octave, the bins are 45254 / 4096 = 11 Hz
+#else
+#ifndef SAMPLES                    // the host benchmark also builds with 1024, bins of 22 Hz
+#define SAMPLES 2048               ///< at sample frequency of 22,627 kHz with 2048 samples, duration is 90 ms.
+#endif
 #define SAMPLE_FREQ 22627          ///< this makes a bin bandwith of 22627 / 2048 = 11 Hz
-#define OCTAVES 9
+#endif
+#define OCTAVE_FIRST_BIN ((SAMPLES / 2) >> OCTAVES)   ///< first bin of the lowest octave, the top octave ends at fs/2
+#define CALIBRATION_SAMPLES 2048   ///< FFT size of the calibration, band energies grow with the size squared
+#define FIXED_PRESHIFT 5           ///< left shift of the 24 bit samples into Q31 in the fixed point pipeline
 
-const int BLOCK_SIZE = SAMPLES;
+// I2S DMA buffering, together the buffers hold DMA_BUF_COUNT * DMA_BUF_LEN / SAMPLE_FREQ = 362 ms of audio (181 ms wide band)
+// the capture statistics show if a smaller or larger buffer is needed
+#define DMA_BUF_COUNT 8            ///< number of DMA buffers
+#define DMA_BUF_LEN 1024           ///< samples per DMA buffer
+#define EVENT_QUEUE_LEN (2 * DMA_BUF_COUNT)   ///< I2S events that can wait for the capture task
+
+#ifdef RAW_CAPTURE
+// 3 bytes per sample and 10 bits per byte on the line: 68 kB/s needs 680 kbit/s, 136 kB/s wide band 1.36 Mbit/s
+#ifdef WIDE_BAND
+#define CAPTURE_BAUD 2000000
+#else
+#define CAPTURE_BAUD 921600
+#endif
+#endif
+
+#ifdef OVERLAP_FRAMES
+const int BLOCK_SIZE = SAMPLES / 2;  ///< samples read per frame, the window overlaps the previous one by 50%
+#define CAPTURE_SLOTS 3              ///< the DSP uses two half blocks while the capture fills the third
+#else
+const int BLOCK_SIZE = SAMPLES;      ///< samples read per frame
+#define CAPTURE_SLOTS 2              ///< ping-pong, the DSP uses one block while the capture fills the other
+#endif
+#define NO_SLOT 0xFF
+
+#ifdef IIR_FILTERS
+#if defined(FIXED_POINT_DSP) || defined(THIRD_OCTAVES)
+  #error IIR_FILTERS measures whole octaves in float math
+#endif
+// the filters give mean squares, this is the energy of the same signal in the HANN windowed FFT:
+// N/2 (one sided spectrum) * sum of the squared window, the window of arduinoFFT is 0.54 * (1 - cos)
+// so the sum is N * 1.5 * 0.54^2
+#define IIR_ENERGY_SCALE (0.75 * 0.54 * 0.54 * SAMPLES * SAMPLES)
+#endif
+
+/// \brief a block of samples handed off from the capture task to the DSP
+struct CaptureBlock {
+  uint8_t  slot;                     ///< slot in the sample ring
+  uint32_t time;                     ///< micros() when the block was complete
+};
 
 class SoundSensor {
   public:
@@ -47,33 +106,125 @@ class SoundSensor {
     bool running()  { return _i2s; }
     
     // Read multiple samples at once and calculate the sound pressure
-    // returns energy in octave bands
+    // returns energy in BANDS bands, whole octaves or third octaves
     float* readSamples();
     void offset( float dB);       ///< mic. correction in dB
 
+    /// \brief the DSP of one frame without the capture, the window is older followed by newer, SAMPLES/2 each
+    /// the new samples are the half block newer with OVERLAP_FRAMES, otherwise the whole block at older
+    /// the buffers may be overwritten, returns energy in BANDS bands like readSamples()
+    float* process(int32_t *older, int32_t *newer);
+
+#ifdef IIR_FILTERS
+    /// \brief A and C weighted energy of the last frame, from the weighting filters
+    const float* weighted()  { return _weighted; }
+#endif
+
+    /// \brief DSP time as fraction of the audio time since the previous call, 1.0 means no headroom left
+    float load();
+
+    /// \brief print DSP load, headroom, capture overruns and capture to DSP latency since the previous report
+    /// the headroom is the part of a frame time left after the longest frame
+    void report();
+
+#ifdef DSP_PROFILE
+    /// \brief profile of the last report interval, published by report(), may be read from the other core
+    ProfileSummary profile() const;
+#endif
+
+    friend class Benchmark;           ///< host benchmark, native/bench.cpp, times the private DSP stages
+
   private:
-    arduinoFFT   *_fft;               ///< FFT class
-    // FFT buffers
+#if defined(IIR_FILTERS)
+    OctaveFilterBank<OCTAVES - 1> _octaves; ///< the top octave is a high pass, the others band passes
+    IirFilter<3>  _aWeighting;
+    IirFilter<2>  _cWeighting;
+    float         _real[BLOCK_SIZE];  ///< DC free samples, work buffer of the filter bank
+    float         _weighted[WEIGHTED_CURVES];
+#elif defined(FIXED_POINT_DSP)
+    FixedRealFft<SAMPLES> _transform; ///< fixed point real input FFT, in place on _samples
+    int32_t       _window[SAMPLES / 2]; ///< first half of the HANN window in Q30
+#ifdef OVERLAP_FRAMES
+    int32_t       _fixed[SAMPLES];    ///< FFT buffer, the samples in the ring are needed for the next frame
+#endif
+#else
+    RealFft<SAMPLES> _transform;      ///< real input FFT specialized for SAMPLES
+    float         _window[SAMPLES / 2]; ///< first half of the HANN window
+    // FFT buffer, real input and packed real spectrum output (no imaginary buffer needed)
     float         _real[SAMPLES];
-    float         _imag[SAMPLES];
-    float         _energy[OCTAVES];
-    int32_t       _samples[BLOCK_SIZE];
+#endif
+    BandMap       _bands;             ///< FFT bins of each band
+    float         _energy[BANDS];
+    int32_t       _samples[CAPTURE_SLOTS * BLOCK_SIZE];  ///< I2S samples, a ring of blocks filled by the capture task
+    uint8_t       _last;              ///< slot of the previous block, the older half of an overlapped window
+    boolean       _primed;            ///< DSP holds the older half of the window
+    uint32_t      _busy;              ///< DSP time in us since the previous load()
+    uint32_t      _frames;            ///< frames since the previous load()
+    uint32_t      _busyMax;           ///< longest DSP time of a frame in us since the previous report()
+    uint32_t      _latencySum;        ///< capture to DSP time in us since the previous report()
+    uint32_t      _latencyMax;
+#ifdef RAW_CAPTURE
+    uint8_t       _frame[CAPTURE_BYTES(BLOCK_SIZE)];  ///< frame of the block streamed over the serial port
+    uint32_t      _streamed;          ///< blocks streamed
+    boolean       _restart;           ///< the next block is the first after a start
+#endif
+#ifdef DSP_PROFILE
+    ProfileStats  _profile[PROFILE_STAGES];  ///< cycles per stage since the previous report()
+    portMUX_TYPE  _readLock = portMUX_INITIALIZER_UNLOCKED;  ///< the read stage is added by the capture task and taken by report()
+    ProfileSummary _summaries[2];     ///< published profiles, double buffered
+    std::atomic<uint32_t> _summarySeq;  ///< twice the number of published profiles, odd during a publish, the last one is in _summaries[(_summarySeq >> 1) & 1]
+#endif
+
+    // capture task, runs on the audio core with a higher priority than the DSP
+    TaskHandle_t  _captureTask;
+    QueueHandle_t _events;            ///< I2S driver events
+    QueueHandle_t _full;              ///< blocks from the capture task to the DSP
+    SemaphoreHandle_t _free;          ///< free slots, given by the DSP when it is done with a block
+    volatile uint32_t _blocks;        ///< blocks captured
+    volatile uint32_t _overruns;      ///< DMA buffers dropped by the driver because the capture was too late
+    volatile uint32_t _dmaErrors;     ///< DMA error events
+    volatile boolean  _resync;        ///< I2S restarted, restart the DMA buffer accounting
+    uint32_t      _dmaDone;           ///< DMA buffers filled, from the I2S events
+    uint32_t      _samplesRead;       ///< samples taken from the DMA buffers
+
+    static void captureTask(void *parameter);
+    void capture();
+    void countEvents();
     float         _runningDC = 0.0;   // compensate MEMS DC offset
     int           _runningN = 0;      // running DSC offset average count
-    float         _factor;            ///< mic. correction factor
+    float         _gain;              ///< scale of the 24 bit samples, includes the mic. correction factor
     esp_err_t     _err;               ///< Variable to store errors from ESP32
     boolean       _i2s;
 
-    /// \brief Convert integer to float
-    void integerToFloat(int32_t *samples, float *vReal, float *vImag, uint16_t size);
-    
-    // calculates energy from Re and Im parts and places it back in the Re part (Im part is zeroed)
-    void calculateEnergy(float *vReal, float *vImag, uint16_t samples);
+    /// \brief read a number of samples from I2S, waits until they are available
+    void readBlock(int32_t *samples, int count);
+
+    /// \brief next block from the capture task, waits until it is available
+    void receiveBlock(CaptureBlock &block);
+#ifdef RAW_CAPTURE
+    /// \brief write the samples of a block as one frame over the serial port, see capture.h
+    void stream(const int32_t *samples);
+#endif
+    int32_t* slot(uint8_t index) { return _samples + index * BLOCK_SIZE; }
+
+    /// \brief Convert integer to float, DC removed, scaled and windowed in one pass
+    /// the window is read from two halves, older holds samples 0 .. size/2-1, newer the rest
+    void integerToFloat(const int32_t *older, const int32_t *newer, float *vReal, uint16_t size);
+
+    /// \brief Convert integer to windowed Q31, DC removed in the same pass, vFixed may be the samples buffer
+    void integerToFixed(const int32_t *older, const int32_t *newer, int32_t *vFixed, uint16_t size);
+
+    /// \brief Convert integer to float, DC removed and scaled, no window
+    void integerToLevel(const int32_t *samples, float *v, uint16_t size);
+
+    float blockMean(const int32_t *samples, uint16_t size);
+    void updateDC(float mean);
+
+    // sums up energy of the fixed point spectrum in the bands of the map, 64 bit accumulators
+    void sumEnergyFixed(const int32_t *spectrum, int8_t exponent, const BandMap &map, float *energies);
     
-    // sums up energy in whole octave bins
-    void sumEnergy(const float *samples, float *energies);
-    // sums up energy in terts bins
-    void sumEnergy3(const float *samples, float *energies);
+    // calculates energy of the packed real spectrum and sums it up in the bands of the map
+    void sumEnergy(const float *spectrum, const BandMap &map, float *energies);
 }; 
 
 #endif // __SOUND_SENSOR_H_
@@ -6,13 +6,35 @@ function decodeUplink(input) {
   // byte 0: a constant (this constant is a multiply factor to correct byte values 1 upto 18)
   // byte 1-9: 9 bytes containg la.min, la.max, la.avg, lc.min, lc.max, lc.avg, lz.min, lz.max, lz.avg
   // byte 10-18: 9 bytes containing lz spectrum representing octaves from 31.5Hz to 8kHz
+  // on port 23 the spectrum has 27 bytes (byte 10-36) representing third octaves from 25Hz to 10kHz
+  // on port 25 the spectrum has 10 bytes (byte 10-19) representing octaves from 31.5Hz to 16kHz
+  // on port 24 the spectrum has 10 bytes (byte 10-19) representing octaves from 16Hz to 8kHz (IIR filters)
+  // on port 26 the spectrum has 11 bytes (byte 10-20) representing octaves from 16Hz to 16kHz (IIR filters, wide band)
+  // after the spectrum 4 bytes may follow with the rolling LAeq over 1, 5, 15 and 60 minutes
+  // and then 3 bytes with LAFmax, LASmax and LAImax (fast, slow and impulse time weighted max)
+  // and then 5 bytes with the statistical levels LA5, LA10, LA50, LA90 and LA95, 49 bytes on port 23
+  // port 30 carries the DSP profile of the audio core (DSP_PROFILE_UPLINK), 16 bit values are little endian:
+  // byte 0: duty cycle in 0.5% steps, byte 1: headroom in % (signed)
+  // byte 2-21: mean and max of the stages read, convert, transform, bands and frame in 10 us steps
+  // byte 22-25: mean and max of the measurement update in us, byte 26-29: DMA overruns and frames lost
   // the payload formatter calculates from the lz spectrum the lc and la spectrum
   // the constant in byte 0 corrects the values in byte 1 upto 18
   // by Marcel Meek, May 2020
   
-  // weigthing tables
-  var aWeighting = [ -39.4, -26.2, -16.1, -8.6, -3.2, 0.0, 1.2, 1.0, -1.1 ];
-  var cWeighting = [  -3.0,  -0.8,  -0.2,  0.0,  0.0, 0.0, 0.2, 0.3, -3.0 ];
+  // weigthing tables of all octaves 16Hz .. 16kHz, a port uses the octaves first .. last
+  var aWeighting = [ -56.7, -39.4, -26.2, -16.1, -8.6, -3.2, 0.0, 1.2, 1.0, -1.1, -6.6 ];
+  var cWeighting = [  -8.5,  -3.0,  -0.8,  -0.2,  0.0,  0.0, 0.0, 0.2, 0.3, -3.0, -8.5 ];
+  var octaves = { 22: [1, 9], 24: [0, 9], 25: [1, 10], 26: [0, 10] };
+  if (input.fPort === 23) {   // third octaves 25Hz .. 10kHz
+    aWeighting = [ -44.7, -39.4, -34.6, -30.2, -26.2, -22.5, -19.1, -16.1, -13.4, -10.9, -8.6, -6.6, -4.8, -3.2, -1.9, -0.8, 0.0, 0.6, 1.0, 1.2, 1.3, 1.2, 1.0, 0.5, -0.1, -1.1, -2.5 ];
+    cWeighting = [  -4.4,  -3.0,  -2.0,  -1.3,  -0.8,  -0.5,  -0.3,  -0.2,  -0.1,   0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0, 0.0, 0.0,-0.1,-0.2,-0.3,-0.5,-0.8,-1.3, -2.0, -3.0, -4.4 ];
+  }
+  else if (input.fPort in octaves) {
+    var first = octaves[input.fPort][0];
+    var last = octaves[input.fPort][1];
+    aWeighting = aWeighting.slice(first, last + 1);
+    cWeighting = cWeighting.slice(first, last + 1);
+  }
   var len = aWeighting.length;
 
   var decoded = {};  // json result
@@ -20,7 +42,7 @@ function decodeUplink(input) {
   var i = 0;
  
    // decode 19 bytes payload (new format)
-  if (input.fPort === 22) {
+  if (input.fPort === 23 || input.fPort in octaves) {
     var max = bytes[i++];
     var c = max / 255.0;
 
@@ -53,6 +75,43 @@ function decodeUplink(input) {
     decoded.lc.spectrum = [];
     for( j=0; j<len; j++) 
       decoded.lc.spectrum[j] = decoded.lz.spectrum[j] + cWeighting[j];
+
+    // get rolling LAeq, not in the messages of older sensors
+    if (bytes.length >= i + 4) {
+      decoded.la.leq1m = c * bytes[i++];
+      decoded.la.leq5m = c * bytes[i++];
+      decoded.la.leq15m = c * bytes[i++];
+      decoded.la.leq60m = c * bytes[i++];
+    }
+
+    // get time weighted max levels, not in the messages of older sensors
+    if (bytes.length >= i + 3) {
+      decoded.la.fmax = c * bytes[i++];
+      decoded.la.smax = c * bytes[i++];
+      decoded.la.imax = c * bytes[i++];
+    }
+
+    // get statistical levels, not in the messages of older sensors
+    if (bytes.length >= i + 5) {
+      decoded.la.l5 = c * bytes[i++];
+      decoded.la.l10 = c * bytes[i++];
+      decoded.la.l50 = c * bytes[i++];
+      decoded.la.l90 = c * bytes[i++];
+      decoded.la.l95 = c * bytes[i++];
+    }
+  }
+  else if (input.fPort === 30 && bytes.length >= 30) {
+    var word = function() { i += 2; return bytes[i - 2] + 256 * bytes[i - 1]; };
+    decoded.profile = {};
+    decoded.profile.duty = bytes[i++] / 2.0;
+    decoded.profile.headroom = (bytes[i] > 127) ? bytes[i++] - 256 : bytes[i++];
+    var stages = [ "read", "convert", "transform", "bands", "frame" ];
+    for (j = 0; j < stages.length; j++) {
+      decoded.profile[stages[j]] = { mean: 10 * word(), max: 10 * word() };
+    }
+    decoded.profile.measurement = { mean: word(), max: word() };
+    decoded.profile.overruns = word();
+    decoded.profile.framesLost = word();
   }
 
   return { data: decoded, warnings: [], errors: [] };